@@ -0,0 +1,47 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <zephyr/sys/util.h>
+
+#include <zmk/behavior.h>
+
+/*
+ * encoded HID usage ごとの共有 refcount テーブル（モジュール全体で1つ）
+ * - 0->1 で press、1->0 で release だけが HID に届く
+ * - &rk 以外の behavior からも同じテーブルを使えるように公開する
+ */
+
+/*
+ * 戻り値: 1 = HID へ遷移を送った / 0 = 吸収した / <0 = エラー
+ * - 物理キーの position は press を記録するので、同じ position の二重 press / release は無視される
+ * - release の keycode が press 時と違っても（レイヤー変更）、その position を押した entry を離す
+ * - virtual position（sensor / combo 等）は回数だけ数える（press と release は呼び出し側で対にする）
+ */
+int zmk_refcount_key_press(uint32_t encoded, uint32_t position, int64_t timestamp);
+int zmk_refcount_key_release(uint32_t encoded, uint32_t position, int64_t timestamp);
+
+/* 現在の参照数（未追跡なら 0） */
+uint16_t zmk_refcount_key_count(uint32_t encoded);
+
+/*
+ * &kp を指す binding を &rk インスタンスへ差し替える（CONFIG_ZMK_REFCOUNT_KEY_ROUTE_KP）
+ * - 差し替えたら true
+ * - queue 経由の順序はそのまま保たれる
+ */
+bool zmk_refcount_key_route_binding(struct zmk_behavior_binding *binding);
+
+#if IS_ENABLED(CONFIG_ZMK_REFCOUNT_KEY_STATS)
+struct zmk_refcount_key_stats {
+    uint32_t emitted;  // HID に届いた press/release
+    uint32_t absorbed; // refcount で吸収した press/release
+};
+
+void zmk_refcount_key_get_stats(struct zmk_refcount_key_stats *out);
+void zmk_refcount_key_reset_stats(void);
+#endif
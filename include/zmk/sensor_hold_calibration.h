@@ -0,0 +1,40 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * sensor hold 系 behavior の timeout-ms / anti-reverse-ms を実際のプレイから推定する
+ * - sensor ごとに detent 間隔と「逆向き1発だけ」のチャタリング間隔を固定バケットのヒストグラムで記録
+ * - timeout は hold をつないだ同方向 detent 間隔の p99.9 + margin、anti-reverse はチャタリング間隔の p99 + margin
+ * - apply した値は behavior 側が timeout_ms()/anti_reverse_ms() で読む
+ */
+
+struct zmk_sensor_hold_cal_recommendation {
+    uint32_t samples;         // 記録した同方向 detent 間隔の数
+    uint32_t chatter_samples; // 記録したチャタリングの数
+    uint16_t timeout_ms;      // 0 = データ不足
+    uint16_t anti_reverse_ms; // 0 = チャタリングが MIN_SAMPLES 未満
+};
+
+/*
+ * process() で detent ごとに呼ぶ（anti-reverse で丸める前の生の方向: 1 = CW, 2 = CCW）
+ * timeout_ms はその instance の今の timeout（適用済みの推奨値を含む）。これ以上空いた間隔は記録しない
+ */
+void zmk_sensor_hold_cal_record(int sensor_index, uint8_t dir, uint32_t now_ms,
+                                uint16_t timeout_ms);
+
+int zmk_sensor_hold_cal_recommend(int sensor_index,
+                                  struct zmk_sensor_hold_cal_recommendation *out);
+
+/* 推奨値を適用 / 解除 / ヒストグラムを捨てる */
+int zmk_sensor_hold_cal_apply(int sensor_index);
+void zmk_sensor_hold_cal_clear(int sensor_index);
+void zmk_sensor_hold_cal_reset(int sensor_index);
+
+/* 適用済みならその値、無ければ configured をそのまま返す（anti-reverse は configured = 0 なら常に 0） */
+uint16_t zmk_sensor_hold_cal_timeout_ms(int sensor_index, uint16_t configured);
+uint16_t zmk_sensor_hold_cal_anti_reverse_ms(int sensor_index, uint16_t configured);
@@ -0,0 +1,93 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/slist.h>
+
+#include <zmk/behavior_queue.h>
+
+/*
+ * sensor hold 系 behavior / refcount-key の時計・timeout timer・behavior queue
+ * - 通常は k_uptime_get() / k_work_delayable / ZMK の behavior queue そのまま
+ * - CONFIG_ZMK_SENSOR_HOLD_VIRTUAL_CLOCK では仮想時計になり、
+ *   zmk_sensor_hold_clock_advance() で進めたときだけ timer が発火する
+ *   queue も k_work を使わない同期版に置き換わる
+ *   （timeout / anti-reverse / watchdog の挙動を実時間を待たずに決定的に再現するため）
+ */
+
+struct zmk_sensor_hold_timer;
+
+typedef void (*zmk_sensor_hold_timer_handler_t)(struct zmk_sensor_hold_timer *timer);
+
+struct zmk_sensor_hold_timer {
+#if IS_ENABLED(CONFIG_ZMK_SENSOR_HOLD_VIRTUAL_CLOCK)
+    sys_snode_t node;
+    int64_t deadline_ms;
+    bool armed;
+#else
+    struct k_work_delayable work;
+#endif
+    zmk_sensor_hold_timer_handler_t handler;
+};
+
+void zmk_sensor_hold_timer_init(struct zmk_sensor_hold_timer *timer,
+                                zmk_sensor_hold_timer_handler_t handler);
+
+#if IS_ENABLED(CONFIG_ZMK_SENSOR_HOLD_VIRTUAL_CLOCK)
+
+int64_t zmk_sensor_hold_now_ms(void);
+
+/* 期限を now + ms にする（予約済みなら延長） */
+void zmk_sensor_hold_timer_start(struct zmk_sensor_hold_timer *timer, uint32_t ms);
+/* 予約済みでなければ now + ms で予約する（予約済みなら期限はそのまま） */
+void zmk_sensor_hold_timer_schedule(struct zmk_sensor_hold_timer *timer, uint32_t ms);
+void zmk_sensor_hold_timer_stop(struct zmk_sensor_hold_timer *timer);
+
+/* 仮想時計を設定 / 進める。advance は期限順に timer を発火させる（handler 内の再予約も拾う） */
+void zmk_sensor_hold_clock_set(int64_t now_ms);
+void zmk_sensor_hold_clock_advance(uint32_t ms);
+
+/* 計測用: これまでに発火した timer の数（実機なら wakeup の数）と、いま予約中の timer の数 */
+uint32_t zmk_sensor_hold_clock_wakeups(void);
+int zmk_sensor_hold_clock_armed(void);
+
+/*
+ * behavior queue（仮想版）
+ * - ZMK の behavior queue と同じく wait=0 の item は積んだその場で順に処理する
+ * - idle は「未処理の item が無い」
+ */
+bool zmk_sensor_hold_queue_idle(void);
+int zmk_sensor_hold_queue_add(const struct zmk_behavior_binding_event *event,
+                              const struct zmk_behavior_binding *binding, bool pressed);
+
+#else
+
+static inline int64_t zmk_sensor_hold_now_ms(void) { return k_uptime_get(); }
+
+static inline void zmk_sensor_hold_timer_start(struct zmk_sensor_hold_timer *timer, uint32_t ms) {
+    k_work_reschedule(&timer->work, K_MSEC(ms));
+}
+
+static inline void zmk_sensor_hold_timer_schedule(struct zmk_sensor_hold_timer *timer,
+                                                  uint32_t ms) {
+    k_work_schedule(&timer->work, K_MSEC(ms));
+}
+
+static inline void zmk_sensor_hold_timer_stop(struct zmk_sensor_hold_timer *timer) {
+    k_work_cancel_delayable(&timer->work);
+}
+
+/* behavior queue: wait=0 で積む */
+static inline int zmk_sensor_hold_queue_add(const struct zmk_behavior_binding_event *event,
+                                            const struct zmk_behavior_binding *binding,
+                                            bool pressed) {
+    return zmk_behavior_queue_add(event, *binding, pressed, 0);
+}
+
+#endif
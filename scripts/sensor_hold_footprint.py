@@ -0,0 +1,296 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: MIT
+"""
+このモジュールの flash / RAM を機能ごとに集計する
+
+map モード: sensor_hold_footprint.py <zephyr.map> [-v]
+- Zephyr は -ffunction-sections / -fdata-sections でビルドするので
+  入力セクション 1つ = 関数 / 変数 1つ として object とセクション名で振り分ける
+- 初期値付き RAM（.data など load address のある出力セクション）は flash と RAM の両方に数える
+- 呼び出し元に inline された機能（step / anti-reverse など）と文字列（ログ）は
+  セクションからは切り分けられないので "unattributed" に入れる
+
+variant モード: sensor_hold_footprint.py --variants <build dir> [--cmake <cmake>]
+- 有効な機能を1つずつ切ってビルドし直し（<build dir>/sensor_hold_footprint/<option>）、
+  元のビルドとの差を機能の大きさとして出す（inline / ログ込み）
+- board / shield / config などは元のビルドの CMakeCache.txt から引き継ぐ
+"""
+
+import os
+import re
+import subprocess
+import sys
+from collections import defaultdict
+
+UNATTRIBUTED = "unattributed"
+
+# (object, セクション名の正規表現, 機能) — 上から最初に一致したもの
+RULES = [
+    ("", r"^\.rodata\.str|\.str1\.|log_const|log_strings|log_dynamic", "%s: strings / logging" % UNATTRIBUTED),
+    ("behavior_refcount_key", r"watchdog|phys_pressed|suspect|position_listener", "refcount-key: watchdog"),
+    ("behavior_refcount_key", r"stats", "refcount-key: stats"),
+    ("behavior_refcount_key", r"route", "refcount-key: route-kp"),
+    ("behavior_refcount_key", r"", "refcount-key"),
+    ("behavior_sensor_hold_rotate", r"group|chord", "hold-rotate: group"),
+    ("behavior_sensor_hold_rotate", r"_idle|activity|devs", "hold-rotate: flush-on-idle"),
+    ("behavior_sensor_hold_rotate", r"", "hold-rotate"),
+    ("behavior_sensor_hold_step_rotate", r"quick_release|allowed", "hold-step-rotate: quick-release"),
+    ("behavior_sensor_hold_step_rotate", r"_idle|activity", "hold-step-rotate: flush-on-idle"),
+    ("behavior_sensor_hold_step_rotate", r"devs", "hold-step-rotate: instance table"),
+    ("behavior_sensor_hold_step_rotate", r"enqueue_tap", "hold-step-rotate: step"),
+    # process / accept_data には step / anti-reverse が inline されている
+    ("behavior_sensor_hold_step_rotate", r"\.(process|accept_data)$",
+     "%s: hold-step-rotate core + inlined step / anti-reverse" % UNATTRIBUTED),
+    ("behavior_sensor_hold_step_rotate", r"", "hold-step-rotate"),
+    ("sensor_hold_clock", r"", "sensor-hold clock"),
+    ("sensor_hold_calibration", r"shell|cmd_|_one|for_each_sensor", "calibration: shell"),
+    ("sensor_hold_calibration", r"", "calibration"),
+]
+RULES = [(obj, re.compile(pat), feature) for obj, pat, feature in RULES]
+MODULE_OBJECTS = {obj for obj, _, _ in RULES if obj}
+
+# variant モードで切る機能: (Kconfig シンボル, 切ったときの値, 機能)
+VARIANTS = [
+    ("ZMK_BEHAVIOR_SENSOR_HOLD_STEP_ROTATE_QUICK_RELEASE", "n", "hold-step-rotate: quick-release"),
+    ("ZMK_BEHAVIOR_SENSOR_HOLD_STEP_ROTATE_STEP", "n", "hold-step-rotate: step"),
+    ("ZMK_BEHAVIOR_SENSOR_HOLD_STEP_ROTATE_ANTI_REVERSE", "n", "hold-step-rotate: anti-reverse"),
+    ("ZMK_BEHAVIOR_SENSOR_HOLD_ROTATE_GROUP", "n", "hold-rotate: group"),
+    ("ZMK_SENSOR_HOLD_FLUSH_ON_IDLE", "n", "flush-on-idle"),
+    ("ZMK_SENSOR_HOLD_CALIBRATION", "n", "calibration"),
+    ("ZMK_REFCOUNT_KEY_WATCHDOG_MS", "0", "refcount-key: watchdog"),
+    ("ZMK_REFCOUNT_KEY_ROUTE_KP", "n", "refcount-key: route-kp"),
+    ("ZMK_REFCOUNT_KEY_STATS", "n", "refcount-key: stats"),
+    ("ZMK_SENSOR_HOLD_LOG_LEVEL", "0", "logging"),
+]
+
+# 元のビルドから引き継ぐ CMake cache 変数
+FORWARD_CACHE = ["BOARD", "SHIELD", "ZMK_CONFIG", "ZMK_EXTRA_MODULES", "ZEPHYR_EXTRA_MODULES",
+                 "CONF_FILE", "EXTRA_CONF_FILE", "DTC_OVERLAY_FILE", "EXTRA_DTC_OVERLAY_FILE",
+                 "SNIPPET"]
+
+OBJ_RE = re.compile(r"\(?([A-Za-z0-9_]+)\.c\.obj\)?$")
+INPUT_RE = re.compile(r"^ (\S+)?\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S+)$")
+OUTPUT_RE = re.compile(r"^(\S+)\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)(\s+load address)?")
+OUTPUT_CONT_RE = re.compile(r"^\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)(\s+load address.*)?$")
+NON_ALLOC = (".debug", ".comment", ".ARM.attributes", ".stab", ".symtab", ".strtab", ".shstrtab")
+
+
+def feature_of(obj, section):
+    for rule_obj, pat, feature in RULES:
+        if (obj == rule_obj or (rule_obj == "" and obj in MODULE_OBJECTS)) and pat.search(section):
+            return feature
+    return None
+
+
+def is_ram_only(out_name, section):
+    return bool(re.match(r"\.?(bss|noinit)", out_name)) or section.startswith((".bss", ".noinit", "COMMON"))
+
+
+def parse(lines, image=None):
+    """
+    (feature, section, flash, ram) を返す
+    image に list [flash, ram] を渡すと、イメージ全体（出力セクションの合計）も足し込む
+    """
+    in_map = False
+    out_name, out_loaded = None, False
+    pending = None  # セクション名が長いと次の行に address / size が来る
+
+    for line in lines:
+        line = line.rstrip("\n")
+        if not in_map:
+            in_map = line.startswith("Linker script and memory map")
+            continue
+
+        m = OUTPUT_RE.match(line)
+        if m:
+            out_name, out_loaded = m.group(1), m.group(4) is not None
+            pending = None
+            add_image(image, out_name, out_loaded, int(m.group(3), 16))
+            continue
+        if line and not line.startswith(" ") and len(line.split()) == 1:
+            # 出力セクション名が長いと address / size は次の行
+            out_name, out_loaded = line, False
+            pending = "<output>"
+            continue
+        if pending == "<output>":
+            pending = None
+            m = OUTPUT_CONT_RE.match(line)
+            if m:
+                out_loaded = m.group(3) is not None
+                add_image(image, out_name, out_loaded, int(m.group(2), 16))
+                continue
+        if "load address" in line and line.split()[0].startswith("0x"):
+            out_loaded = True
+            continue
+        if line.startswith(" ") and len(line.split()) == 1 and not line.strip().startswith("*"):
+            pending = line.strip()
+            continue
+
+        m = INPUT_RE.match(line)
+        if m is None or out_name is None or out_name.startswith(NON_ALLOC):
+            pending = None
+            continue
+
+        section = m.group(1) or pending or ""
+        pending = None
+        size = int(m.group(3), 16)
+        obj = OBJ_RE.search(m.group(4))
+        if size == 0 or obj is None:
+            continue
+
+        feature = feature_of(obj.group(1), section)
+        if feature is None:
+            continue
+
+        if is_ram_only(out_name, section):
+            yield feature, section, 0, size
+        elif out_loaded:
+            yield feature, section, size, size
+        else:
+            yield feature, section, size, 0
+
+
+def add_image(image, out_name, out_loaded, size):
+    if image is None or out_name.startswith(NON_ALLOC) or size == 0:
+        return
+    if is_ram_only(out_name, ""):
+        image[1] += size
+    else:
+        image[0] += size
+        if out_loaded:
+            image[1] += size
+
+
+def read_map(path):
+    """(機能ごとの [flash, ram], 機能ごとの明細, モジュール合計, イメージ合計)"""
+    totals = defaultdict(lambda: [0, 0])
+    detail = defaultdict(list)
+    image = [0, 0]
+    with open(path, encoding="utf-8", errors="replace") as f:
+        for feature, section, flash, ram in parse(f, image):
+            totals[feature][0] += flash
+            totals[feature][1] += ram
+            detail[feature].append((section, flash, ram))
+    module = [sum(t[0] for t in totals.values()), sum(t[1] for t in totals.values())]
+    return totals, detail, module, image
+
+
+def report_map(path, verbose):
+    totals, detail, module, _ = read_map(path)
+    if not totals:
+        print("no sensor hold / refcount objects found in %s" % path)
+        return 0
+
+    width = max(len(name) for name in totals)
+    print("%-*s %8s %8s" % (width, "feature", "flash", "ram"))
+    for feature in sorted(totals, key=lambda f: (f.startswith(UNATTRIBUTED), f)):
+        flash, ram = totals[feature]
+        print("%-*s %8d %8d" % (width, feature, flash, ram))
+        if verbose:
+            for section, s_flash, s_ram in sorted(detail[feature], key=lambda d: -(d[1] + d[2])):
+                print("  %-*s %8d %8d" % (width - 2, section, s_flash, s_ram))
+    print("%-*s %8d %8d" % (width, "total", module[0], module[1]))
+    if any(f.startswith(UNATTRIBUTED) for f in totals):
+        print("\n%s: inlined feature code and strings; use --variants to attribute them" %
+              UNATTRIBUTED)
+    return 0
+
+
+def read_kv(path, pattern):
+    values = {}
+    if not os.path.exists(path):
+        return values
+    with open(path, encoding="utf-8", errors="replace") as f:
+        for line in f:
+            m = pattern.match(line.rstrip("\n"))
+            if m:
+                values[m.group(1)] = m.group(2)
+    return values
+
+
+def read_config(build_dir):
+    return read_kv(os.path.join(build_dir, "zephyr", ".config"),
+                   re.compile(r"^CONFIG_([A-Za-z0-9_]+)=\"?(.*?)\"?$"))
+
+
+def read_cache(build_dir):
+    return read_kv(os.path.join(build_dir, "CMakeCache.txt"),
+                   re.compile(r"^([A-Za-z0-9_]+):[A-Z]+=(.*)$"))
+
+
+def map_path(build_dir, config):
+    return os.path.join(build_dir, "zephyr", "%s.map" % config.get("KERNEL_BIN_NAME", "zephyr"))
+
+
+def build_variant(cmake, build_dir, cache, option, value):
+    out_dir = os.path.join(build_dir, "sensor_hold_footprint", option)
+    args = [cmake, "-S", cache["APPLICATION_SOURCE_DIR"], "-B", out_dir]
+    if cache.get("CMAKE_GENERATOR"):
+        args += ["-G", cache["CMAKE_GENERATOR"]]
+    args += ["-D%s=%s" % (k, cache[k]) for k in FORWARD_CACHE if cache.get(k)]
+    args += ["-DCONFIG_%s=%s" % (option, value)]
+
+    with open(os.path.join(build_dir, "sensor_hold_footprint_%s.log" % option), "w") as log:
+        for cmd in (args, [cmake, "--build", out_dir]):
+            if subprocess.call(cmd, stdout=log, stderr=subprocess.STDOUT) != 0:
+                return None
+    return map_path(out_dir, read_config(out_dir))
+
+
+def report_variants(build_dir, cmake):
+    config = read_config(build_dir)
+    cache = read_cache(build_dir)
+    if not config or "APPLICATION_SOURCE_DIR" not in cache:
+        print("%s is not a configured Zephyr build directory" % build_dir, file=sys.stderr)
+        return 2
+
+    _, _, base_module, base_image = read_map(map_path(build_dir, config))
+    rows = []
+    for option, value, feature in VARIANTS:
+        if config.get(option, "n") in ("n", "0", ""):
+            continue
+        print("building without %s (CONFIG_%s=%s) ..." % (feature, option, value), flush=True)
+        variant_map = build_variant(cmake, build_dir, cache, option, value)
+        if variant_map is None or not os.path.exists(variant_map):
+            rows.append((feature, option, None, None))
+            continue
+        _, _, module, image = read_map(variant_map)
+        rows.append((feature, option,
+                     [base_module[0] - module[0], base_module[1] - module[1]],
+                     [base_image[0] - image[0], base_image[1] - image[1]]))
+
+    if not rows:
+        print("no optional sensor hold / refcount feature is enabled")
+        return 0
+
+    # 差分は inline されたコードとログの文字列も含む。イメージ側は他の object への波及も含む
+    width = max(len(r[0]) for r in rows)
+    print("%-*s %8s %8s %10s %10s" % (width, "feature", "flash", "ram", "image fl", "image ram"))
+    for feature, option, module, image in rows:
+        if module is None:
+            # DT で使っているプロパティの機能を切ると BUILD_ASSERT で落ちる
+            print("%-*s build failed (see sensor_hold_footprint_%s.log)" % (width, feature, option))
+            continue
+        print("%-*s %8d %8d %10d %10d" % (width, feature, module[0], module[1], image[0], image[1]))
+    print("%-*s %8d %8d %10d %10d" % (width, "all on", base_module[0],
+                                      base_module[1], base_image[0], base_image[1]))
+    return 0
+
+
+def main(argv):
+    if "--variants" in argv:
+        i = argv.index("--variants")
+        if i + 1 >= len(argv):
+            print(__doc__.strip(), file=sys.stderr)
+            return 2
+        cmake = argv[argv.index("--cmake") + 1] if "--cmake" in argv[:-1] else "cmake"
+        return report_variants(argv[i + 1], cmake)
+
+    if len(argv) < 2:
+        print(__doc__.strip(), file=sys.stderr)
+        return 2
+    return report_map(argv[1], "-v" in argv[2:])
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -4,6 +4,8 @@
 
 #define DT_DRV_COMPAT zmk_behavior_refcount_key
 
+#include <string.h>
+
 #include <zephyr/device.h>
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
@@ -13,8 +15,12 @@
 #include <zmk/behavior.h>
 #include <zmk/event_manager.h>
 #include <zmk/events/keycode_state_changed.h>
+#include <zmk/events/position_state_changed.h>
+#include <zmk/matrix.h>
+#include <zmk/refcount_key.h>
+#include <zmk/sensor_hold_clock.h>
 
-LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_SENSOR_HOLD_LOG_LEVEL);
 
 /*
  * encoded HID usage (binding->param1) ごとに refcount を持つ
@@ -25,13 +31,43 @@ LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 #define CONFIG_ZMK_REFCOUNT_KEY_MAX_TRACKED 32
 #endif
 
+#ifndef CONFIG_ZMK_REFCOUNT_KEY_WATCHDOG_MS
+#define CONFIG_ZMK_REFCOUNT_KEY_WATCHDOG_MS 0
+#endif
+
+/*
+ * position ごとの press ビット
+ * - 物理キーの position だけを bitmap で持つ
+ * - virtual position（sensor / combo 等）は untracked として数だけ持つ
+ *   sensor は同じ position から同じ keycode を重ねて押すことがある（hold と同じ keycode の step tap、
+ *   同じ sensor の別レイヤーの hold など）。press / release の対応は各 behavior の slot が保証する
+ */
+#define REFCOUNT_POSITIONS ZMK_KEYMAP_LEN
+#define REFCOUNT_POS_WORDS DIV_ROUND_UP(REFCOUNT_POSITIONS, 32)
+
 struct ref_item {
     uint32_t encoded;
-    uint8_t count;
+    uint16_t count;     // = 立っているビット数 + untracked
+    uint8_t untracked;
+    uint32_t positions[REFCOUNT_POS_WORDS];
 };
 
 static struct ref_item refs[CONFIG_ZMK_REFCOUNT_KEY_MAX_TRACKED];
 
+static inline bool pos_tracked(uint32_t position) { return position < REFCOUNT_POSITIONS; }
+
+static inline bool pos_test(const uint32_t *bits, uint32_t position) {
+    return bits[position / 32] & BIT(position % 32);
+}
+
+static inline void pos_set(uint32_t *bits, uint32_t position) {
+    bits[position / 32] |= BIT(position % 32);
+}
+
+static inline void pos_clear(uint32_t *bits, uint32_t position) {
+    bits[position / 32] &= ~BIT(position % 32);
+}
+
 static struct ref_item *get_or_alloc(uint32_t encoded) {
     struct ref_item *free_slot = NULL;
 
@@ -45,8 +81,7 @@ static struct ref_item *get_or_alloc(uint32_t encoded) {
     }
 
     if (free_slot) {
-        free_slot->encoded = encoded;
-        free_slot->count = 0;
+        *free_slot = (struct ref_item){.encoded = encoded};
         return free_slot;
     }
 
@@ -62,60 +97,247 @@ static struct ref_item *find_existing(uint32_t encoded) {
     return NULL;
 }
 
+// release 側だけで使う: press 後にレイヤーが変わって keycode が食い違った場合の救済
+static struct ref_item *find_by_position(uint32_t position) {
+    for (int i = 0; i < CONFIG_ZMK_REFCOUNT_KEY_MAX_TRACKED; i++) {
+        if (refs[i].count > 0 && pos_test(refs[i].positions, position)) {
+            return &refs[i];
+        }
+    }
+    return NULL;
+}
+
 static int emit_keycode_event(uint32_t encoded, bool pressed, int64_t timestamp) {
     // kp と同じ “ZMKの正規ルート”
     return raise_zmk_keycode_state_changed_from_encoded(encoded, pressed, timestamp);
 }
 
-static int on_keymap_binding_pressed(struct zmk_behavior_binding *binding,
-                                     struct zmk_behavior_binding_event event) {
-    const uint32_t encoded = binding->param1;
+#if IS_ENABLED(CONFIG_ZMK_REFCOUNT_KEY_STATS)
+static struct zmk_refcount_key_stats stats;
+#define STAT_INC(field) (stats.field++)
+#else
+#define STAT_INC(field)
+#endif
+
+#if CONFIG_ZMK_REFCOUNT_KEY_WATCHDOG_MS > 0
+// sensor hold と同じ時計で回す（仮想時計のテストで watchdog も決定的に動く）
+static struct zmk_sensor_hold_timer watchdog_timer;
+
+// count > 0 の間だけ回す（既に予約済みなら何もしない = O(1)）
+static inline void watchdog_kick(void) {
+    zmk_sensor_hold_timer_schedule(&watchdog_timer, CONFIG_ZMK_REFCOUNT_KEY_WATCHDOG_MS);
+}
+#else
+static inline void watchdog_kick(void) {}
+#endif
 
+/* ---- module-wide API ---- */
+
+int zmk_refcount_key_press(uint32_t encoded, uint32_t position, int64_t timestamp) {
     struct ref_item *it = get_or_alloc(encoded);
     if (!it) {
         LOG_ERR("refcount_key: table full (increase CONFIG_ZMK_REFCOUNT_KEY_MAX_TRACKED)");
-        return ZMK_BEHAVIOR_OPAQUE;
+        return -ENOMEM;
     }
 
-    if (it->count == 0) {
-        it->count = 1;
-        LOG_DBG("refcount_key press encoded=0x%08X rc=1 pos=%d", encoded, event.position);
-        (void)emit_keycode_event(encoded, true, event.timestamp);
+    if (pos_tracked(position)) {
+        // 同じ position からの二重 press は数えない（release を冪等にするため）
+        if (pos_test(it->positions, position)) {
+            LOG_DBG("refcount_key press encoded=0x%08X pos=%d already held", encoded, position);
+            return 0;
+        }
+        pos_set(it->positions, position);
     } else {
-        if (it->count < 255) {
-            it->count++;
+        if (it->untracked == UINT8_MAX) {
+            LOG_WRN("refcount_key untracked saturated encoded=0x%08X pos=%d", encoded, position);
+            return 0;
         }
-        LOG_DBG("refcount_key press encoded=0x%08X rc=%u pos=%d", encoded, it->count,
-                event.position);
+        it->untracked++;
     }
+    it->count++;
 
-    return ZMK_BEHAVIOR_OPAQUE;
+    if (it->count == 1) {
+        STAT_INC(emitted);
+        LOG_DBG("refcount_key press encoded=0x%08X rc=1 pos=%d", encoded, position);
+        watchdog_kick();
+        int ret = emit_keycode_event(encoded, true, timestamp);
+        return ret < 0 ? ret : 1;
+    }
+
+    STAT_INC(absorbed);
+    LOG_DBG("refcount_key press encoded=0x%08X rc=%u pos=%d", encoded, it->count, position);
+    return 0;
 }
 
-static int on_keymap_binding_released(struct zmk_behavior_binding *binding,
-                                      struct zmk_behavior_binding_event event) {
-    const uint32_t encoded = binding->param1;
+static int release_item(struct ref_item *it, uint32_t position, int64_t timestamp) {
+    it->count--;
 
+    if (it->count == 0) {
+        STAT_INC(emitted);
+        LOG_DBG("refcount_key release encoded=0x%08X rc=0 (emit) pos=%d", it->encoded, position);
+        // slot は count==0 になったので再利用可能
+        int ret = emit_keycode_event(it->encoded, false, timestamp);
+        return ret < 0 ? ret : 1;
+    }
+
+    STAT_INC(absorbed);
+    LOG_DBG("refcount_key release encoded=0x%08X rc=%u pos=%d", it->encoded, it->count,
+            position);
+    return 0;
+}
+
+int zmk_refcount_key_release(uint32_t encoded, uint32_t position, int64_t timestamp) {
     struct ref_item *it = find_existing(encoded);
-    if (!it) {
-        LOG_WRN("refcount_key release while not tracked encoded=0x%08X pos=%d", encoded,
-                event.position);
-        return ZMK_BEHAVIOR_OPAQUE;
+
+    if (!pos_tracked(position)) {
+        if (!it || it->untracked == 0) {
+            LOG_WRN("refcount_key release while not tracked encoded=0x%08X pos=%d", encoded,
+                    position);
+            return 0;
+        }
+        it->untracked--;
+        return release_item(it, position, timestamp);
     }
 
-    if (it->count > 0) {
-        it->count--;
+    if (!it || !pos_test(it->positions, position)) {
+        // press 時と keycode が違う（レイヤー変更など）: この position を押した entry を離す
+        it = find_by_position(position);
+        if (!it) {
+            LOG_DBG("refcount_key release ignored encoded=0x%08X pos=%d (not pressed)", encoded,
+                    position);
+            return 0;
+        }
     }
 
-    if (it->count == 0) {
-        LOG_DBG("refcount_key release encoded=0x%08X rc=0 (emit) pos=%d", encoded, event.position);
-        (void)emit_keycode_event(encoded, false, event.timestamp);
-        // slot は count==0 になったので再利用可能
+    pos_clear(it->positions, position);
+    return release_item(it, position, timestamp);
+}
+
+uint16_t zmk_refcount_key_count(uint32_t encoded) {
+    struct ref_item *it = find_existing(encoded);
+    return it ? it->count : 0;
+}
+
+/*
+ * &kp -> &rk の差し替え
+ * - &rk インスタンスが1つも無ければ何もしない（テーブルは直接 API からは使える）
+ */
+#if IS_ENABLED(CONFIG_ZMK_REFCOUNT_KEY_ROUTE_KP) && DT_HAS_COMPAT_STATUS_OKAY(DT_DRV_COMPAT) &&    \
+    DT_HAS_COMPAT_STATUS_OKAY(zmk_behavior_key_press)
+static const char *const kp_name =
+    DEVICE_DT_NAME(DT_COMPAT_GET_ANY_STATUS_OKAY(zmk_behavior_key_press));
+static const char *const rk_name = DEVICE_DT_NAME(DT_DRV_INST(0));
+
+bool zmk_refcount_key_route_binding(struct zmk_behavior_binding *binding) {
+    if (binding->behavior_dev == NULL) {
+        return false;
+    }
+    if (binding->behavior_dev != kp_name && strcmp(binding->behavior_dev, kp_name) != 0) {
+        return false;
+    }
+    binding->behavior_dev = rk_name;
+    return true;
+}
+#else
+bool zmk_refcount_key_route_binding(struct zmk_behavior_binding *binding) {
+    ARG_UNUSED(binding);
+    return false;
+}
+#endif
+
+#if IS_ENABLED(CONFIG_ZMK_REFCOUNT_KEY_STATS)
+void zmk_refcount_key_get_stats(struct zmk_refcount_key_stats *out) { *out = stats; }
+
+void zmk_refcount_key_reset_stats(void) { stats = (struct zmk_refcount_key_stats){0}; }
+#endif
+
+#if CONFIG_ZMK_REFCOUNT_KEY_WATCHDOG_MS > 0
+/*
+ * stuck-key watchdog
+ * - 物理キーの実状態を position_state_changed から bitmap で持つ
+ * - 「refcount 上は押しているのに物理的には離れている」状態が2回連続で見えたら離す
+ *   （hold-tap などで release 直後に press が来るケースを1周期ぶん見逃すため）
+ * - sensor / untracked は対象外（sensor は各 behavior の timeout が面倒を見る）
+ */
+static uint32_t phys_pressed[REFCOUNT_POS_WORDS];
+static uint32_t suspect[REFCOUNT_POS_WORDS];
+
+static int refcount_position_listener(const zmk_event_t *eh) {
+    const struct zmk_position_state_changed *ev = as_zmk_position_state_changed(eh);
+    if (ev == NULL || ev->position >= ZMK_KEYMAP_LEN) {
+        return ZMK_EV_EVENT_BUBBLE;
+    }
+
+    if (ev->state) {
+        pos_set(phys_pressed, ev->position);
     } else {
-        LOG_DBG("refcount_key release encoded=0x%08X rc=%u pos=%d", encoded, it->count,
-                event.position);
+        pos_clear(phys_pressed, ev->position);
     }
+    return ZMK_EV_EVENT_BUBBLE;
+}
+
+ZMK_LISTENER(behavior_refcount_key_watchdog, refcount_position_listener);
+ZMK_SUBSCRIPTION(behavior_refcount_key_watchdog, zmk_position_state_changed);
+
+static void watchdog_timer_handler(struct zmk_sensor_hold_timer *timer) {
+    ARG_UNUSED(timer);
+
+    uint32_t mismatch[REFCOUNT_POS_WORDS] = {0};
+    bool any_active = false;
+    const int64_t now = zmk_sensor_hold_now_ms();
 
+    for (int i = 0; i < CONFIG_ZMK_REFCOUNT_KEY_MAX_TRACKED; i++) {
+        struct ref_item *it = &refs[i];
+        if (it->count == 0) {
+            continue;
+        }
+
+        for (uint32_t pos = 0; pos < ZMK_KEYMAP_LEN; pos++) {
+            if (!pos_test(it->positions, pos) || pos_test(phys_pressed, pos)) {
+                continue;
+            }
+            if (pos_test(suspect, pos)) {
+                LOG_WRN("refcount_key watchdog: stuck encoded=0x%08X pos=%d", it->encoded, pos);
+                pos_clear(it->positions, pos);
+                release_item(it, pos, now);
+                if (it->count == 0) {
+                    break;
+                }
+            } else {
+                pos_set(mismatch, pos);
+            }
+        }
+
+        any_active |= (it->count > 0);
+    }
+
+    memcpy(suspect, mismatch, sizeof(suspect));
+
+    if (any_active) {
+        watchdog_kick();
+    }
+}
+
+// &rk インスタンスの数に関係なく1回だけ（仮想時計は timer をリストに登録するので二重登録しない）
+static int refcount_watchdog_init(void) {
+    zmk_sensor_hold_timer_init(&watchdog_timer, watchdog_timer_handler);
+    return 0;
+}
+
+SYS_INIT(refcount_watchdog_init, POST_KERNEL, CONFIG_KERNEL_INIT_PRIORITY_DEFAULT);
+#endif
+
+/* ---- behavior implementation ---- */
+
+static int on_keymap_binding_pressed(struct zmk_behavior_binding *binding,
+                                     struct zmk_behavior_binding_event event) {
+    (void)zmk_refcount_key_press(binding->param1, event.position, event.timestamp);
+    return ZMK_BEHAVIOR_OPAQUE;
+}
+
+static int on_keymap_binding_released(struct zmk_behavior_binding *binding,
+                                      struct zmk_behavior_binding_event event) {
+    (void)zmk_refcount_key_release(binding->param1, event.position, event.timestamp);
     return ZMK_BEHAVIOR_OPAQUE;
 }
 
@@ -11,20 +11,20 @@
 #include <drivers/behavior.h>
 
 #include <zmk/behavior.h>
-#include <zmk/behavior_queue.h>
+#include <zmk/keymap.h>
+#include <zmk/sensors.h>
 #include <zmk/virtual_key_position.h>
 #include <zmk/events/position_state_changed.h>
+#include <zmk/sensor_hold_calibration.h>
 
-#ifndef ZMK_KEYMAP_SENSORS_LEN
-#define ZMK_KEYMAP_SENSORS_LEN 0
-#endif
+#include "sensor_hold_common.h"
 
-#ifndef ZMK_KEYMAP_LAYERS_LEN
-#define ZMK_KEYMAP_LAYERS_LEN 1
+#if IS_ENABLED(CONFIG_ZMK_SENSOR_HOLD_FLUSH_ON_IDLE)
+#include <zmk/event_manager.h>
+#include <zmk/events/activity_state_changed.h>
 #endif
 
-
-LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_SENSOR_HOLD_LOG_LEVEL);
 
 /*
  * 目的:
@@ -39,75 +39,416 @@ LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
  */
 
 struct behavior_sensor_hold_rotate_config {
-    struct zmk_behavior_binding cw_binding;
-    struct zmk_behavior_binding ccw_binding;
+    // [HOLD_DIR_CW - 1] = CW, [HOLD_DIR_CCW - 1] = CCW
+    struct zmk_behavior_binding bindings[2];
     uint16_t timeout_ms;
+    bool direct_dispatch;
 };
 
-enum hold_dir {
-    HOLD_DIR_NONE = 0,
-    HOLD_DIR_CW = 1,
-    HOLD_DIR_CCW = 2,
-};
-
+/*
+ * hot: detent ごとに触るものだけ（binding は cfg 側の index で持つ）
+ * - position / layer は [sensor][layer] の添字から復元できるので持たない
+ */
 struct hold_state {
-    bool inited;
-    bool active;
-    struct zmk_behavior_binding active_binding;
-
-    int16_t last_position;
-    uint8_t last_layer;
+    uint8_t pending_dir; // accept_data で方向を貯めておく（processで消費）
+    uint8_t active_dir;  // 押している binding の方向。NONE なら非 active
+};
 
-    struct k_work_delayable release_work;
+/* cold: timeout 用。detent ごとには reschedule しか触らない */
+struct hold_timer {
+    struct zmk_sensor_hold_timer work;
+    const struct device *dev;
 };
 
+#if IS_ENABLED(CONFIG_ZMK_BEHAVIOR_SENSOR_HOLD_ROTATE_GROUP)
+struct hold_group;
+#endif
 
 struct behavior_sensor_hold_rotate_data {
-    // accept_data で方向を貯めておく（processで消費）
-    enum hold_dir pending_dir[ZMK_KEYMAP_SENSORS_LEN][ZMK_KEYMAP_LAYERS_LEN];
     struct hold_state state[ZMK_KEYMAP_SENSORS_LEN][ZMK_KEYMAP_LAYERS_LEN];
+    struct hold_timer timer[ZMK_KEYMAP_SENSORS_LEN][ZMK_KEYMAP_LAYERS_LEN];
+#if IS_ENABLED(CONFIG_ZMK_BEHAVIOR_SENSOR_HOLD_ROTATE_GROUP)
+    // zmk,sensor-hold-rotate-group のメンバーなら init で紐付ける（NULL = 単独）
+    struct hold_group *group;
+    uint8_t member;
+#endif
 };
 
-static int enqueue_press(struct zmk_behavior_binding_event *event,
-                         struct zmk_behavior_binding binding) {
-    return zmk_behavior_queue_add(event, binding, true, 0);
+/* 全インスタンス合計の active hold 数（sensor_hold_set_active 参照） */
+static atomic_t active_holds;
+
+static inline void set_active_dir(struct hold_state *st, uint8_t dir) {
+    sensor_hold_set_active(&active_holds, &st->active_dir, dir);
 }
 
-static int enqueue_release(struct zmk_behavior_binding_event *event,
-                           struct zmk_behavior_binding binding) {
-    return zmk_behavior_queue_add(event, binding, false, 0);
+static inline const struct zmk_behavior_binding *
+dir_binding(const struct behavior_sensor_hold_rotate_config *cfg, uint8_t dir) {
+    return &cfg->bindings[dir - 1];
 }
 
-static bool binding_equal(struct zmk_behavior_binding a, struct zmk_behavior_binding b) {
-    return (a.behavior_dev == b.behavior_dev) && (a.param1 == b.param1) && (a.param2 == b.param2);
+static inline int dispatch(const struct behavior_sensor_hold_rotate_config *cfg,
+                           struct zmk_behavior_binding_event *event,
+                           const struct zmk_behavior_binding *binding, bool pressed) {
+    return sensor_hold_dispatch(cfg->direct_dispatch, event, binding, pressed);
 }
 
-static void arm_timeout(const struct behavior_sensor_hold_rotate_config *cfg,
-                        struct hold_state *st) {
+static int enqueue_press(const struct behavior_sensor_hold_rotate_config *cfg,
+                         struct zmk_behavior_binding_event *event, uint8_t dir) {
+    return dispatch(cfg, event, dir_binding(cfg, dir), true);
+}
+
+static int enqueue_release(const struct behavior_sensor_hold_rotate_config *cfg,
+                           struct zmk_behavior_binding_event *event, uint8_t dir) {
+    return dispatch(cfg, event, dir_binding(cfg, dir), false);
+}
+
+static uint16_t timeout_for(const struct behavior_sensor_hold_rotate_config *cfg,
+                            int sensor_index) {
     uint16_t ms = cfg->timeout_ms ? cfg->timeout_ms : 180;
-    if (ms < 1) ms = 1;
-    k_work_reschedule(&st->release_work, K_MSEC(ms));
+#if IS_ENABLED(CONFIG_ZMK_SENSOR_HOLD_CALIBRATION)
+    ms = zmk_sensor_hold_cal_timeout_ms(sensor_index, ms);
+#else
+    ARG_UNUSED(sensor_index);
+#endif
+    return (ms < 1) ? 1 : ms;
 }
 
-static void release_work_handler(struct k_work *work) {
-    struct k_work_delayable *dwork = k_work_delayable_from_work(work);
-    struct hold_state *st = CONTAINER_OF(dwork, struct hold_state, release_work);
+static void arm_timeout(const struct behavior_sensor_hold_rotate_config *cfg,
+                        struct hold_timer *tm, int sensor_index) {
+    zmk_sensor_hold_timer_start(&tm->work, timeout_for(cfg, sensor_index));
+}
+
+static void release_slot(const struct device *dev, int sensor_index, int layer,
+                         bool cancel_timer) {
+    const struct behavior_sensor_hold_rotate_config *cfg = dev->config;
+    struct behavior_sensor_hold_rotate_data *data = dev->data;
+    struct hold_state *st = &data->state[sensor_index][layer];
 
-    if (!st->active) {
+    // 非 active なら timer は予約されていないので触らない
+    if (st->active_dir == HOLD_DIR_NONE) {
         return;
     }
 
     struct zmk_behavior_binding_event ev = {
-        .position = st->last_position,
-        .layer = st->last_layer,
-        .timestamp = (uint32_t)k_uptime_get(),
+        .position = ZMK_VIRTUAL_KEY_POSITION_SENSOR(sensor_index),
+        .layer = layer,
+        .timestamp = (uint32_t)zmk_sensor_hold_now_ms(),
     };
 
-    LOG_DBG("timeout release pos=%d layer=%d", ev.position, ev.layer);
-    enqueue_release(&ev, st->active_binding);
-    st->active = false;
+    LOG_DBG("release pos=%d layer=%d", ev.position, ev.layer);
+    enqueue_release(cfg, &ev, st->active_dir);
+    set_active_dir(st, HOLD_DIR_NONE);
+
+    if (cancel_timer) {
+        zmk_sensor_hold_timer_stop(&data->timer[sensor_index][layer].work);
+    }
+}
+
+static void release_work_handler(struct zmk_sensor_hold_timer *timer) {
+    struct hold_timer *tm = CONTAINER_OF(timer, struct hold_timer, work);
+    struct behavior_sensor_hold_rotate_data *data = tm->dev->data;
+
+    // timer の添字から sensor / layer を復元
+    const int idx = tm - &data->timer[0][0];
+
+    release_slot(tm->dev, idx / ZMK_KEYMAP_LAYERS_LEN, idx % ZMK_KEYMAP_LAYERS_LEN, false);
+}
+
+#if IS_ENABLED(CONFIG_ZMK_BEHAVIOR_SENSOR_HOLD_ROTATE_GROUP)
+/*
+ * group mode（zmk,sensor-hold-rotate-group ノードが2つの hold-rotate インスタンスを連動させる）:
+ * - メンバーは別インスタンスなので、binding / timeout-ms / direct-dispatch はメンバーごと
+ * - 2つの hold は1つの timer（release 期限）を共有し、期限切れで一緒に離す
+ * - 両方が active で、どちらの直近 detent も chord-window-ms 以内の間だけ個別 hold を chord binding に置き換える
+ *   （片方が止まって window を過ぎたら、次の detent で chord をやめて個別 hold に戻す）
+ * - chord がある group では、1つ目のメンバーが単独で動き出したときの press を chord-window-ms だけ待たせる
+ *   （combo と同じ。相方が window 内に来たら個別 hold を出さずに chord だけを press する）
+ *   window を過ぎたら、または待たせたまま離すことになったら、その時点で個別 hold を出す
+ * - 遷移は group_sync でまとめて出す（release を先に、press を後に。間に他の処理を挟まない）
+ */
+#define GROUP_COMPAT zmk_sensor_hold_rotate_group
+
+struct hold_group_config {
+    const struct device *members[2];
+    uint16_t chord_window_ms;
+    // chord-bindings: [CW,CW] [CW,CCW] [CCW,CW] [CCW,CCW]（members[0] の方向, members[1] の方向）
+    uint8_t chord_count; // 0 => chord 無効
+    struct zmk_behavior_binding chords[4];
+};
+
+/* layer ごとに1つ */
+struct hold_group_state {
+    uint32_t last_ms[2];    // メンバーの直近 detent 時刻
+    uint32_t release_ms;    // 共有の release 期限
+    uint32_t held_since_ms; // held_back を始めた時刻
+    uint8_t sensor[2];      // メンバーが直近に動いた sensor index
+    uint8_t active_dir[2];  // メンバーの論理的な hold 方向。NONE なら非 active
+    uint8_t emitted_dir[2]; // 実際に押している個別 binding（chord 中は NONE）
+    uint8_t chord;          // 押している chord binding の index + 1。0 = なし
+    uint8_t held_back;      // press を待たせているメンバーの index + 1。0 = なし
+};
+
+struct hold_group_timer {
+    struct zmk_sensor_hold_timer work;
+    struct hold_group *group;
+};
+
+struct hold_group {
+    const struct hold_group_config *cfg;
+    struct hold_group_state state[ZMK_KEYMAP_LAYERS_LEN];
+    struct hold_group_timer timer[ZMK_KEYMAP_LAYERS_LEN];
+};
+
+#define _CHORD_ENTRY(idx, node)                                                                    \
+    {                                                                                              \
+        .behavior_dev = DEVICE_DT_NAME(DT_PHANDLE_BY_IDX(node, chord_bindings, idx)),              \
+        .param1 = COND_CODE_0(DT_PHA_HAS_CELL_AT_IDX(node, chord_bindings, idx, param1), (0),      \
+                              (DT_PHA_BY_IDX(node, chord_bindings, idx, param1))),                 \
+        .param2 = COND_CODE_0(DT_PHA_HAS_CELL_AT_IDX(node, chord_bindings, idx, param2), (0),      \
+                              (DT_PHA_BY_IDX(node, chord_bindings, idx, param2))),                 \
+    }
+
+#define GROUP_MEMBER(node, idx) DT_PHANDLE_BY_IDX(node, members, idx)
+
+#define GROUP_ASSERT(node)                                                                         \
+    BUILD_ASSERT(DT_PROP_LEN(node, members) == 2, "members must list exactly two instances");     \
+    BUILD_ASSERT(DT_NODE_HAS_COMPAT(GROUP_MEMBER(node, 0), DT_DRV_COMPAT) &&                       \
+                     DT_NODE_HAS_COMPAT(GROUP_MEMBER(node, 1), DT_DRV_COMPAT),                     \
+                 "members must be zmk,behavior-sensor-hold-rotate instances");                     \
+    BUILD_ASSERT(!DT_SAME_NODE(GROUP_MEMBER(node, 0), GROUP_MEMBER(node, 1)),                      \
+                 "members must be two different instances");                                       \
+    BUILD_ASSERT(DT_PROP_LEN_OR(node, chord_bindings, 0) == 0 ||                                   \
+                     DT_PROP_LEN_OR(node, chord_bindings, 0) == 4,                                 \
+                 "chord-bindings must have four entries");
+
+#define GROUP_ENTRY(node)                                                                          \
+    {                                                                                              \
+        .cfg = &(const struct hold_group_config){                                                  \
+            .members = {DEVICE_DT_GET(GROUP_MEMBER(node, 0)),                                      \
+                        DEVICE_DT_GET(GROUP_MEMBER(node, 1))},                                     \
+            .chord_window_ms = DT_PROP_OR(node, chord_window_ms, 30),                              \
+            .chord_count = DT_PROP_LEN_OR(node, chord_bindings, 0),                                \
+            .chords = {COND_CODE_1(DT_NODE_HAS_PROP(node, chord_bindings),                         \
+                                   (LISTIFY(DT_PROP_LEN(node, chord_bindings), _CHORD_ENTRY, (,),  \
+                                            node)),                                                \
+                                   ())},                                                           \
+        },                                                                                         \
+    },
+
+DT_FOREACH_STATUS_OKAY(GROUP_COMPAT, GROUP_ASSERT)
+
+static struct hold_group groups[] = {DT_FOREACH_STATUS_OKAY(GROUP_COMPAT, GROUP_ENTRY)};
+
+static inline uint8_t chord_for(uint8_t dir0, uint8_t dir1) {
+    return (uint8_t)((dir0 - 1) * 2 + (dir1 - 1) + 1);
+}
+
+/* chord は両方が window 内に動いている間だけ。止まった方がいれば個別 hold に戻す */
+static uint8_t group_want_chord(const struct hold_group_config *gcfg,
+                                const struct hold_group_state *gs, uint32_t now) {
+    if (gcfg->chord_count == 4 && gs->active_dir[0] != HOLD_DIR_NONE &&
+        gs->active_dir[1] != HOLD_DIR_NONE && now - gs->last_ms[0] <= gcfg->chord_window_ms &&
+        now - gs->last_ms[1] <= gcfg->chord_window_ms) {
+        return chord_for(gs->active_dir[0], gs->active_dir[1]);
+    }
+    return 0;
+}
+
+static void group_sync(struct hold_group *g, int layer) {
+    const struct hold_group_config *gcfg = g->cfg;
+    struct hold_group_state *gs = &g->state[layer];
+    const struct behavior_sensor_hold_rotate_config *mcfg[2] = {gcfg->members[0]->config,
+                                                               gcfg->members[1]->config};
+    const uint32_t now = (uint32_t)zmk_sensor_hold_now_ms();
+
+    struct zmk_behavior_binding_event ev[2];
+    for (int i = 0; i < 2; i++) {
+        ev[i] = (struct zmk_behavior_binding_event){
+            .position = ZMK_VIRTUAL_KEY_POSITION_SENSOR(gs->sensor[i]),
+            .layer = layer,
+            .timestamp = now,
+        };
+#if IS_ENABLED(CONFIG_ZMK_SPLIT)
+        ev[i].source = ZMK_POSITION_STATE_CHANGE_SOURCE_LOCAL;
+#endif
+    }
+
+    // ---- 出したい状態を決める ----
+    const uint8_t want_chord = group_want_chord(gcfg, gs, now);
+
+    // 待たせている press は chord になったか、window を過ぎたら終わり
+    if (gs->held_back && (want_chord || now - gs->held_since_ms >= gcfg->chord_window_ms)) {
+        gs->held_back = 0;
+    }
+
+    uint8_t want_emit[2];
+    for (int i = 0; i < 2; i++) {
+        want_emit[i] = (want_chord || gs->held_back == i + 1) ? HOLD_DIR_NONE : gs->active_dir[i];
+    }
+
+    // ---- release を先に ----
+    if (gs->chord && gs->chord != want_chord) {
+        LOG_DBG("group chord release %d", gs->chord - 1);
+        dispatch(mcfg[0], &ev[0], &gcfg->chords[gs->chord - 1], false);
+        gs->chord = 0;
+    }
+    for (int i = 0; i < 2; i++) {
+        if (gs->emitted_dir[i] != HOLD_DIR_NONE && gs->emitted_dir[i] != want_emit[i]) {
+            enqueue_release(mcfg[i], &ev[i], gs->emitted_dir[i]);
+            gs->emitted_dir[i] = HOLD_DIR_NONE;
+        }
+    }
+
+    // ---- press を後に ----
+    if (want_chord && gs->chord != want_chord) {
+        LOG_DBG("group chord press %d", want_chord - 1);
+        dispatch(mcfg[0], &ev[0], &gcfg->chords[want_chord - 1], true);
+        gs->chord = want_chord;
+    }
+    for (int i = 0; i < 2; i++) {
+        if (want_emit[i] != HOLD_DIR_NONE && gs->emitted_dir[i] != want_emit[i]) {
+            enqueue_press(mcfg[i], &ev[i], want_emit[i]);
+            gs->emitted_dir[i] = want_emit[i];
+        }
+    }
+}
+
+/*
+ * メンバーを離す（member < 0 なら両方）
+ * - そのメンバーの press を待たせていたら、先に press を出してから離す（detent を落とさない）
+ */
+static void group_deactivate(struct hold_group *g, int layer, int member) {
+    struct hold_group_state *gs = &g->state[layer];
+
+    if (gs->held_back && (member < 0 || gs->held_back == member + 1)) {
+        gs->held_back = 0;
+        group_sync(g, layer);
+    }
+    for (int i = 0; i < 2; i++) {
+        if (member < 0 || member == i) {
+            sensor_hold_set_active(&active_holds, &gs->active_dir[i], HOLD_DIR_NONE);
+        }
+    }
+    group_sync(g, layer);
+}
+
+/* 共有 timer は release 期限と、press を待たせていればその window の終わりの早い方で起こす */
+static void group_arm(struct hold_group *g, int layer) {
+    struct hold_group_state *gs = &g->state[layer];
+    const uint32_t now = (uint32_t)zmk_sensor_hold_now_ms();
+    uint32_t ms = gs->release_ms - now;
+
+    if (gs->held_back) {
+        ms = MIN(ms, gs->held_since_ms + g->cfg->chord_window_ms - now);
+    }
+    zmk_sensor_hold_timer_start(&g->timer[layer].work, ms);
+}
+
+static void group_release_work_handler(struct zmk_sensor_hold_timer *timer) {
+    struct hold_group_timer *tm = CONTAINER_OF(timer, struct hold_group_timer, work);
+    struct hold_group *g = tm->group;
+    struct hold_group_state *gs;
+
+    const int layer = tm - &g->timer[0];
+    gs = &g->state[layer];
+
+    if ((int32_t)((uint32_t)zmk_sensor_hold_now_ms() - gs->release_ms) < 0) {
+        // chord-window-ms が過ぎた: 待たせていた press を出して、release 期限で取り直す
+        LOG_DBG("group chord window expired layer=%d", layer);
+        group_sync(g, layer);
+        group_arm(g, layer);
+        return;
+    }
+
+    LOG_DBG("group timeout release layer=%d", layer);
+    group_deactivate(g, layer, -1);
+}
+
+#if IS_ENABLED(CONFIG_ZMK_SENSOR_HOLD_FLUSH_ON_IDLE)
+static void group_release(struct hold_group *g, int layer) {
+    struct hold_group_state *gs = &g->state[layer];
+
+    if (gs->active_dir[0] == HOLD_DIR_NONE && gs->active_dir[1] == HOLD_DIR_NONE) {
+        return;
+    }
+
+    group_deactivate(g, layer, -1);
+    zmk_sensor_hold_timer_stop(&g->timer[layer].work);
+}
+#endif
+
+static int group_process(struct hold_group *g, int member, int sensor_index, int layer,
+                         uint8_t dir) {
+    const struct hold_group_config *gcfg = g->cfg;
+    struct hold_group_state *gs = &g->state[layer];
+    const uint32_t now = (uint32_t)zmk_sensor_hold_now_ms();
+
+    // 同じメンバーの別 sensor が動いたら、前の sensor の hold を先に離す（press と同じ position で release する）
+    if (gs->active_dir[member] != HOLD_DIR_NONE && gs->sensor[member] != sensor_index) {
+        group_deactivate(g, layer, member);
+    }
+
+    // 単独で動き出したメンバーの press は相方を chord-window-ms だけ待つ
+    if (gcfg->chord_count == 4 && gcfg->chord_window_ms > 0 &&
+        gs->active_dir[member] == HOLD_DIR_NONE && gs->active_dir[!member] == HOLD_DIR_NONE) {
+        gs->held_back = member + 1;
+        gs->held_since_ms = now;
+    }
+
+    gs->sensor[member] = sensor_index;
+    gs->last_ms[member] = now;
+    sensor_hold_set_active(&active_holds, &gs->active_dir[member], dir);
+    if (gs->held_back && group_want_chord(gcfg, gs, now)) {
+        gs->held_back = 0; // 相方が window 内に来た（group_arm が window の終わりで起こさないように先に消す）
+    }
+
+    // 共有の release 期限は active なメンバーのうち遅い方に合わせる。dispatch より先に予約する
+    uint16_t ms = 0;
+    for (int i = 0; i < 2; i++) {
+        if (gs->active_dir[i] != HOLD_DIR_NONE) {
+            ms = MAX(ms, timeout_for(gcfg->members[i]->config, gs->sensor[i]));
+        }
+    }
+    gs->release_ms = now + ms;
+    group_arm(g, layer);
+    group_sync(g, layer);
+    return ZMK_BEHAVIOR_OPAQUE;
 }
 
+/* init: この instance を含む group があれば紐付ける（group の timer は members[0] の init で用意） */
+static int group_link(const struct device *dev) {
+    struct behavior_sensor_hold_rotate_data *data = dev->data;
+
+    for (int gi = 0; gi < ARRAY_SIZE(groups); gi++) {
+        struct hold_group *g = &groups[gi];
+
+        for (int i = 0; i < 2; i++) {
+            if (g->cfg->members[i] != dev) {
+                continue;
+            }
+            if (data->group != NULL) {
+                LOG_ERR("sensor_hold_rotate: %s is a member of more than one group", dev->name);
+                return -EINVAL;
+            }
+            data->group = g;
+            data->member = i;
+
+            if (i == 0) {
+                for (int ly = 0; ly < ZMK_KEYMAP_LAYERS_LEN; ly++) {
+                    zmk_sensor_hold_timer_init(&g->timer[ly].work, group_release_work_handler);
+                    g->timer[ly].group = g;
+                }
+            }
+        }
+    }
+    return 0;
+}
+#else
+// group ノードがあるのに Kconfig で外れていたら黙って無視せずビルドを止める
+BUILD_ASSERT(!DT_HAS_COMPAT_STATUS_OKAY(zmk_sensor_hold_rotate_group),
+             "zmk,sensor-hold-rotate-group needs CONFIG_ZMK_BEHAVIOR_SENSOR_HOLD_ROTATE_GROUP");
+#endif
+
 static int accept_data(struct zmk_behavior_binding *binding,
                        struct zmk_behavior_binding_event event,
                        const struct zmk_sensor_config *sensor_config,
@@ -121,6 +462,7 @@ static int accept_data(struct zmk_behavior_binding *binding,
     struct behavior_sensor_hold_rotate_data *data = dev->data;
 
     const int sensor_index = ZMK_SENSOR_POSITION_FROM_VIRTUAL_KEY_POSITION(event.position);
+    struct hold_state *st = &data->state[sensor_index][event.layer];
 
     const struct sensor_value v = channel_data[0].value;
 
@@ -128,16 +470,15 @@ static int accept_data(struct zmk_behavior_binding *binding,
     int delta = (v.val1 == 0) ? v.val2 : v.val1;
 
     if (delta > 0) {
-        data->pending_dir[sensor_index][event.layer] = HOLD_DIR_CW;
+        st->pending_dir = HOLD_DIR_CW;
     } else if (delta < 0) {
-        data->pending_dir[sensor_index][event.layer] = HOLD_DIR_CCW;
+        st->pending_dir = HOLD_DIR_CCW;
     } else {
-        data->pending_dir[sensor_index][event.layer] = HOLD_DIR_NONE;
+        st->pending_dir = HOLD_DIR_NONE;
     }
 
     LOG_DBG("accept pos=%d layer=%d val1=%d val2=%d delta=%d dir=%d",
-            event.position, event.layer, v.val1, v.val2, delta,
-            data->pending_dir[sensor_index][event.layer]);
+            event.position, event.layer, v.val1, v.val2, delta, st->pending_dir);
 
     return 0;
 }
@@ -150,14 +491,15 @@ static int process(struct zmk_behavior_binding *binding,
     struct behavior_sensor_hold_rotate_data *data = dev->data;
 
     const int sensor_index = ZMK_SENSOR_POSITION_FROM_VIRTUAL_KEY_POSITION(event.position);
+    struct hold_state *st = &data->state[sensor_index][event.layer];
 
     if (mode != BEHAVIOR_SENSOR_BINDING_PROCESS_MODE_TRIGGER) {
-        data->pending_dir[sensor_index][event.layer] = HOLD_DIR_NONE;
+        st->pending_dir = HOLD_DIR_NONE;
         return ZMK_BEHAVIOR_TRANSPARENT;
     }
 
-    enum hold_dir dir = data->pending_dir[sensor_index][event.layer];
-    data->pending_dir[sensor_index][event.layer] = HOLD_DIR_NONE;
+    const uint8_t dir = st->pending_dir;
+    st->pending_dir = HOLD_DIR_NONE;
 
     if (dir == HOLD_DIR_NONE) {
         return ZMK_BEHAVIOR_TRANSPARENT;
@@ -167,50 +509,107 @@ static int process(struct zmk_behavior_binding *binding,
     event.source = ZMK_POSITION_STATE_CHANGE_SOURCE_LOCAL;
 #endif
 
-    struct zmk_behavior_binding next =
-        (dir == HOLD_DIR_CW) ? cfg->cw_binding : cfg->ccw_binding;
-
-    struct hold_state *st = &data->state[sensor_index][event.layer];
+#if IS_ENABLED(CONFIG_ZMK_SENSOR_HOLD_CALIBRATION)
+    zmk_sensor_hold_cal_record(sensor_index, dir, (uint32_t)zmk_sensor_hold_now_ms(),
+                               timeout_for(cfg, sensor_index));
+#endif
 
-    // 初回だけ init（毎回でも害はない）
-    if (!st->inited) {
-        k_work_init_delayable(&st->release_work, release_work_handler);
-        st->inited = true;
+#if IS_ENABLED(CONFIG_ZMK_BEHAVIOR_SENSOR_HOLD_ROTATE_GROUP)
+    if (data->group != NULL) {
+        return group_process(data->group, data->member, sensor_index, event.layer, dir);
     }
+#endif
 
-    // timeout release 用の情報を更新
-    st->last_position = event.position;
-    st->last_layer = event.layer;
+    struct hold_timer *tm = &data->timer[sensor_index][event.layer];
 
-    if (!st->active) {
-        st->active = true;
-        st->active_binding = next;
+    /*
+     * timeout は dispatch より先に予約する
+     * - direct-dispatch だと binding がここで同期的に走り、その keycode を見た listener が
+     *   この slot を離して timer を止めることがある。後から予約すると非 active の slot に timer が残る
+     */
+    if (st->active_dir == HOLD_DIR_NONE) {
+        set_active_dir(st, dir);
         LOG_DBG("press start dir=%s", (dir == HOLD_DIR_CW) ? "cw" : "ccw");
-        enqueue_press(&event, next);
-        arm_timeout(cfg, st);
+        arm_timeout(cfg, tm, sensor_index);
+        enqueue_press(cfg, &event, dir);
         return ZMK_BEHAVIOR_OPAQUE;
     }
 
-    if (binding_equal(st->active_binding, next)) {
+    if (st->active_dir == dir ||
+        sensor_hold_binding_equal(dir_binding(cfg, st->active_dir), dir_binding(cfg, dir))) {
         LOG_DBG("extend hold");
-        arm_timeout(cfg, st);
+        arm_timeout(cfg, tm, sensor_index);
         return ZMK_BEHAVIOR_OPAQUE;
     }
 
     LOG_DBG("switch hold");
-    enqueue_release(&event, st->active_binding);
-    st->active_binding = next;
-    enqueue_press(&event, next);
-    arm_timeout(cfg, st);
+    const uint8_t prev_dir = st->active_dir;
+    set_active_dir(st, dir);
+    arm_timeout(cfg, tm, sensor_index);
+    enqueue_release(cfg, &event, prev_dir);
+    enqueue_press(cfg, &event, dir);
 
     return ZMK_BEHAVIOR_OPAQUE;
 }
 
+#if IS_ENABLED(CONFIG_ZMK_SENSOR_HOLD_FLUSH_ON_IDLE)
+/* ---- idle/sleep 前に hold を全部離す ---- */
+#define GET_DEV(inst) DEVICE_DT_INST_GET(inst),
+static const struct device *devs[] = {DT_INST_FOREACH_STATUS_OKAY(GET_DEV)};
+
+static int hold_rotate_activity_listener(const zmk_event_t *eh) {
+    const struct zmk_activity_state_changed *ev = as_zmk_activity_state_changed(eh);
+    if (ev == NULL || ev->state == ZMK_ACTIVITY_ACTIVE || atomic_get(&active_holds) == 0) {
+        return ZMK_EV_EVENT_BUBBLE;
+    }
+
+#if IS_ENABLED(CONFIG_ZMK_BEHAVIOR_SENSOR_HOLD_ROTATE_GROUP)
+    for (int gi = 0; gi < ARRAY_SIZE(groups); gi++) {
+        for (int ly = 0; ly < ZMK_KEYMAP_LAYERS_LEN; ly++) {
+            group_release(&groups[gi], ly);
+        }
+    }
+#endif
+
+    for (int di = 0; di < ARRAY_SIZE(devs); di++) {
+        const struct device *dev = devs[di];
+
+        for (int ly = 0; ly < ZMK_KEYMAP_LAYERS_LEN; ly++) {
+            for (int si = 0; si < ZMK_KEYMAP_SENSORS_LEN; si++) {
+                release_slot(dev, si, ly, true);
+            }
+        }
+    }
+
+    return ZMK_EV_EVENT_BUBBLE;
+}
+
+ZMK_LISTENER(behavior_sensor_hold_rotate_idle, hold_rotate_activity_listener);
+ZMK_SUBSCRIPTION(behavior_sensor_hold_rotate_idle, zmk_activity_state_changed);
+#endif
+
 static const struct behavior_driver_api api = {
     .sensor_binding_accept_data = accept_data,
     .sensor_binding_process = process,
 };
 
+static int init(const struct device *dev) {
+    struct behavior_sensor_hold_rotate_data *data = dev->data;
+
+    for (int si = 0; si < ZMK_KEYMAP_SENSORS_LEN; si++) {
+        for (int ly = 0; ly < ZMK_KEYMAP_LAYERS_LEN; ly++) {
+            zmk_sensor_hold_timer_init(&data->timer[si][ly].work, release_work_handler);
+            data->timer[si][ly].dev = dev;
+        }
+    }
+
+#if IS_ENABLED(CONFIG_ZMK_BEHAVIOR_SENSOR_HOLD_ROTATE_GROUP)
+    return group_link(dev);
+#else
+    return 0;
+#endif
+}
+
 #define _TRANSFORM_ENTRY(idx, node)                                                                \
     {                                                                                              \
         .behavior_dev = DEVICE_DT_NAME(DT_INST_PHANDLE_BY_IDX(node, bindings, idx)),               \
@@ -221,14 +620,15 @@ static const struct behavior_driver_api api = {
     }
 
 #define INST(n)                                                                                     \
+    SENSOR_HOLD_DIRECT_DISPATCH_ASSERT(n)                                                           \
     static const struct behavior_sensor_hold_rotate_config cfg_##n = {                              \
-        .cw_binding  = _TRANSFORM_ENTRY(0, n),                                                      \
-        .ccw_binding = _TRANSFORM_ENTRY(1, n),                                                      \
-        .timeout_ms  = DT_INST_PROP_OR(n, timeout_ms, 180),                                         \
+        .bindings = {_TRANSFORM_ENTRY(0, n), _TRANSFORM_ENTRY(1, n)},                               \
+        .timeout_ms = DT_INST_PROP_OR(n, timeout_ms, 180),                                          \
+        .direct_dispatch = DT_INST_PROP_OR(n, direct_dispatch, 0),                                  \
     };                                                                                              \
     static struct behavior_sensor_hold_rotate_data data_##n = {};                                   \
     BEHAVIOR_DT_INST_DEFINE(                                                                        \
-        n, NULL, NULL, &data_##n, &cfg_##n,                                                         \
+        n, init, NULL, &data_##n, &cfg_##n,                                                         \
         POST_KERNEL, CONFIG_KERNEL_INIT_PRIORITY_DEFAULT,                                           \
         &api);
 
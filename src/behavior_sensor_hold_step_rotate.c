@@ -11,32 +11,27 @@
 #include <drivers/behavior.h>
 
 #include <zmk/behavior.h>
-#include <zmk/behavior_queue.h>
 #include <zmk/virtual_key_position.h>
 #include <zmk/events/position_state_changed.h>
+#include <zmk/sensor_hold_calibration.h>
 
 #include <zmk/event_manager.h>
+#if IS_ENABLED(CONFIG_ZMK_BEHAVIOR_SENSOR_HOLD_STEP_ROTATE_QUICK_RELEASE)
 #include <zmk/events/keycode_state_changed.h>
+#endif
+#if IS_ENABLED(CONFIG_ZMK_SENSOR_HOLD_FLUSH_ON_IDLE)
+#include <zmk/events/activity_state_changed.h>
+#endif
 
 #include <zmk/hid.h>
 #include <zmk/keys.h>
 #include <zmk/keymap.h>
+#include <zmk/sensors.h>
 
-#ifndef ZMK_KEYMAP_SENSORS_LEN
-#define ZMK_KEYMAP_SENSORS_LEN 0
-#endif
-
-#ifndef ZMK_KEYMAP_LAYERS_LEN
-#define ZMK_KEYMAP_LAYERS_LEN 1
-#endif
+#include "sensor_hold_common.h"
 
-LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_LOG_LEVEL);
 
-enum hold_dir {
-    HOLD_DIR_NONE = 0,
-    HOLD_DIR_CW = 1,
-    HOLD_DIR_CCW = 2,
-};
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_SENSOR_HOLD_LOG_LEVEL);
 
 enum hold_mode {
     HOLD_MODE_SWITCH = 0,
@@ -49,54 +44,84 @@ struct allow_item {
 };
 
 struct behavior_sensor_hold_step_rotate_config {
-    struct zmk_behavior_binding hold_cw;
-    struct zmk_behavior_binding hold_ccw;
-    struct zmk_behavior_binding step_cw;
-    struct zmk_behavior_binding step_ccw;
+    // [HOLD_DIR_CW - 1] = CW, [HOLD_DIR_CCW - 1] = CCW
+    struct zmk_behavior_binding hold[2];
+#if IS_ENABLED(CONFIG_ZMK_BEHAVIOR_SENSOR_HOLD_STEP_ROTATE_STEP)
+    struct zmk_behavior_binding step[2];
+#endif
 
     uint16_t timeout_ms;
+#if IS_ENABLED(CONFIG_ZMK_BEHAVIOR_SENSOR_HOLD_STEP_ROTATE_STEP)
     uint16_t step_group_size;     // 0 => step disabled
+#endif
     uint8_t direction_hold_mode;
 
     bool require_top_layer;
 
+#if IS_ENABLED(CONFIG_ZMK_BEHAVIOR_SENSOR_HOLD_STEP_ROTATE_ANTI_REVERSE)
     // ★追加：逆方向チャタリング抑制（ms）。0なら無効。
     uint16_t anti_reverse_ms;
+#endif
+
+    // queue を通さず直接 binding を呼ぶ（opt-in）
+    bool direct_dispatch;
 
+#if IS_ENABLED(CONFIG_ZMK_BEHAVIOR_SENSOR_HOLD_STEP_ROTATE_QUICK_RELEASE)
     // quick-release
     bool quick_release;
     uint8_t allow_count;
     struct allow_item allow_list[];
+#endif
 };
 
+/*
+ * hot: detent ごとに触るものだけを詰めた 12 byte のレコード
+ * - binding はコピーせず cfg 側の index（= 方向）で持つ
+ * - position / layer は [sensor][layer] の添字から復元できるので持たない
+ * - step / anti-reverse を Kconfig で外すとその分のフィールドも消える（両方外せば 2 byte）
+ */
 struct hold_state {
-    bool inited;
-    bool active;
-    struct zmk_behavior_binding active_binding;
-
-    int16_t last_position;
-    uint8_t last_layer;
-
+#if IS_ENABLED(CONFIG_ZMK_BEHAVIOR_SENSOR_HOLD_STEP_ROTATE_ANTI_REVERSE)
+    // ★追加：方向履歴（チャタリング抑制用）。zmk_sensor_hold_now_ms 基準（差分は wrap しても OK）
+    uint32_t last_dir_time_ms;
+#endif
+#if IS_ENABLED(CONFIG_ZMK_BEHAVIOR_SENSOR_HOLD_STEP_ROTATE_STEP)
     uint16_t step_count;
+#endif
+    uint8_t pending_dir; // accept_data で貯めて process で消費
+    uint8_t active_dir;  // 押している hold binding の方向。NONE なら非 active
+#if IS_ENABLED(CONFIG_ZMK_BEHAVIOR_SENSOR_HOLD_STEP_ROTATE_ANTI_REVERSE)
+    uint8_t last_dir;
+#endif
+};
 
-    // ★追加：方向履歴（チャタリング抑制用）
-    enum hold_dir last_dir;
-    int64_t last_dir_time_ms;
-
-    struct k_work_delayable release_work;
+/* cold: timeout 用。detent ごとには reschedule しか触らない */
+struct hold_timer {
+    struct zmk_sensor_hold_timer work;
+    const struct device *dev;
 };
 
 struct behavior_sensor_hold_step_rotate_data {
-    enum hold_dir pending_dir[ZMK_KEYMAP_SENSORS_LEN][ZMK_KEYMAP_LAYERS_LEN];
     struct hold_state state[ZMK_KEYMAP_SENSORS_LEN][ZMK_KEYMAP_LAYERS_LEN];
+    struct hold_timer timer[ZMK_KEYMAP_SENSORS_LEN][ZMK_KEYMAP_LAYERS_LEN];
 };
 
+#if IS_ENABLED(CONFIG_ZMK_BEHAVIOR_SENSOR_HOLD_STEP_ROTATE_QUICK_RELEASE) ||                          \
+    IS_ENABLED(CONFIG_ZMK_SENSOR_HOLD_FLUSH_ON_IDLE)
 /* ---- instance list (caps_word style) ---- */
 #define GET_DEV(inst) DEVICE_DT_INST_GET(inst),
 static const struct device *devs[] = {DT_INST_FOREACH_STATUS_OKAY(GET_DEV)};
+#endif
+
+/* 全インスタンス合計の active hold 数（sensor_hold_set_active 参照） */
+static atomic_t active_holds;
 
 /* ---- helpers ---- */
 
+static inline void set_active_dir(struct hold_state *st, uint8_t dir) {
+    sensor_hold_set_active(&active_holds, &st->active_dir, dir);
+}
+
 static inline bool is_top_layer(uint8_t layer) {
     return layer == (uint8_t)zmk_keymap_highest_layer_active();
 }
@@ -105,78 +130,105 @@ static inline bool gate_layer(const struct behavior_sensor_hold_step_rotate_conf
     return (!cfg->require_top_layer) || is_top_layer(layer);
 }
 
-static inline bool binding_is_valid(const struct zmk_behavior_binding b) {
-    return b.behavior_dev && b.behavior_dev[0] != '\0';
+static inline bool binding_is_valid(const struct zmk_behavior_binding *b) {
+    return b->behavior_dev && b->behavior_dev[0] != '\0';
+}
+
+// tap も含めて同じ経路を通すので press/tap/release の順序は崩れない
+static inline int dispatch(const struct behavior_sensor_hold_step_rotate_config *cfg,
+                           struct zmk_behavior_binding_event *event,
+                           const struct zmk_behavior_binding *binding, bool pressed) {
+    return sensor_hold_dispatch(cfg->direct_dispatch, event, binding, pressed);
 }
 
-static int enqueue_press(struct zmk_behavior_binding_event *event,
-                         struct zmk_behavior_binding binding) {
+static int enqueue_press(const struct behavior_sensor_hold_step_rotate_config *cfg,
+                         struct zmk_behavior_binding_event *event, uint8_t dir) {
+    const struct zmk_behavior_binding *binding = &cfg->hold[dir - 1];
     if (!binding_is_valid(binding)) {
         return ZMK_BEHAVIOR_OPAQUE;
     }
-    return zmk_behavior_queue_add(event, binding, true, 0);
+    return dispatch(cfg, event, binding, true);
 }
 
-static int enqueue_release(struct zmk_behavior_binding_event *event,
-                           struct zmk_behavior_binding binding) {
+static int enqueue_release(const struct behavior_sensor_hold_step_rotate_config *cfg,
+                           struct zmk_behavior_binding_event *event, uint8_t dir) {
+    const struct zmk_behavior_binding *binding = &cfg->hold[dir - 1];
     if (!binding_is_valid(binding)) {
         return ZMK_BEHAVIOR_OPAQUE;
     }
-    return zmk_behavior_queue_add(event, binding, false, 0);
+    return dispatch(cfg, event, binding, false);
 }
 
-static int enqueue_tap(struct zmk_behavior_binding_event *event,
-                       struct zmk_behavior_binding binding) {
+#if IS_ENABLED(CONFIG_ZMK_BEHAVIOR_SENSOR_HOLD_STEP_ROTATE_STEP)
+static int enqueue_tap(const struct behavior_sensor_hold_step_rotate_config *cfg,
+                       struct zmk_behavior_binding_event *event, uint8_t dir) {
+    const struct zmk_behavior_binding *binding = &cfg->step[dir - 1];
     if (!binding_is_valid(binding)) {
         return ZMK_BEHAVIOR_OPAQUE;
     }
-    zmk_behavior_queue_add(event, binding, true, 0);
-    return zmk_behavior_queue_add(event, binding, false, 0);
+    dispatch(cfg, event, binding, true);
+    return dispatch(cfg, event, binding, false);
 }
+#endif
 
-static bool binding_equal(struct zmk_behavior_binding a, struct zmk_behavior_binding b) {
-    return (a.behavior_dev == b.behavior_dev) && (a.param1 == b.param1) && (a.param2 == b.param2);
+static uint16_t timeout_for(const struct behavior_sensor_hold_step_rotate_config *cfg,
+                            int sensor_index) {
+    uint16_t ms = cfg->timeout_ms ? cfg->timeout_ms : 180;
+#if IS_ENABLED(CONFIG_ZMK_SENSOR_HOLD_CALIBRATION)
+    ms = zmk_sensor_hold_cal_timeout_ms(sensor_index, ms);
+#else
+    ARG_UNUSED(sensor_index);
+#endif
+    return (ms < 1) ? 1 : ms;
 }
 
 static void arm_timeout(const struct behavior_sensor_hold_step_rotate_config *cfg,
-                        struct hold_state *st) {
-    uint16_t ms = cfg->timeout_ms ? cfg->timeout_ms : 180;
-    if (ms < 1) ms = 1;
-    k_work_reschedule(&st->release_work, K_MSEC(ms));
+                        struct hold_timer *tm, int sensor_index) {
+    zmk_sensor_hold_timer_start(&tm->work, timeout_for(cfg, sensor_index));
 }
 
-static void force_release_state(const struct behavior_sensor_hold_step_rotate_config *cfg,
-                                struct hold_state *st,
-                                bool cancel_timer) {
-    ARG_UNUSED(cfg);
-
-    if (!st->active) {
-        st->step_count = 0;
-        if (cancel_timer) {
-            k_work_cancel_delayable(&st->release_work);
-        }
-        return;
-    }
-
+static inline struct zmk_behavior_binding_event state_event(int sensor_index, int layer) {
     struct zmk_behavior_binding_event ev = {
-        .position = st->last_position,
-        .layer = st->last_layer,
-        .timestamp = (uint32_t)k_uptime_get(),
+        .position = ZMK_VIRTUAL_KEY_POSITION_SENSOR(sensor_index),
+        .layer = layer,
+        .timestamp = (uint32_t)zmk_sensor_hold_now_ms(),
     };
 
 #if IS_ENABLED(CONFIG_ZMK_SPLIT)
     ev.source = ZMK_POSITION_STATE_CHANGE_SOURCE_LOCAL;
 #endif
 
-    enqueue_release(&ev, st->active_binding);
-    st->active = false;
+    return ev;
+}
+
+static void force_release_state(const struct device *dev, int sensor_index, int layer,
+                                bool cancel_timer) {
+    const struct behavior_sensor_hold_step_rotate_config *cfg = dev->config;
+    struct behavior_sensor_hold_step_rotate_data *data = dev->data;
+    struct hold_state *st = &data->state[sensor_index][layer];
+
+    // 非 active なら timer は予約されていないので cancel も不要
+    if (st->active_dir == HOLD_DIR_NONE) {
+#if IS_ENABLED(CONFIG_ZMK_BEHAVIOR_SENSOR_HOLD_STEP_ROTATE_STEP)
+        st->step_count = 0;
+#endif
+        return;
+    }
+
+    struct zmk_behavior_binding_event ev = state_event(sensor_index, layer);
+
+    enqueue_release(cfg, &ev, st->active_dir);
+    set_active_dir(st, HOLD_DIR_NONE);
+#if IS_ENABLED(CONFIG_ZMK_BEHAVIOR_SENSOR_HOLD_STEP_ROTATE_STEP)
     st->step_count = 0;
+#endif
 
     if (cancel_timer) {
-        k_work_cancel_delayable(&st->release_work);
+        zmk_sensor_hold_timer_stop(&data->timer[sensor_index][layer].work);
     }
 }
 
+#if IS_ENABLED(CONFIG_ZMK_BEHAVIOR_SENSOR_HOLD_STEP_ROTATE_QUICK_RELEASE)
 static bool is_allowed_key(const struct behavior_sensor_hold_step_rotate_config *cfg,
                            uint16_t usage_page, uint16_t usage_id) {
     if (cfg->allow_count == 0) {
@@ -189,40 +241,33 @@ static bool is_allowed_key(const struct behavior_sensor_hold_step_rotate_config
     }
     return false;
 }
+#endif
 
 /* ---- timeout handler ---- */
 
-static void release_work_handler(struct k_work *work) {
-    struct k_work_delayable *dwork = k_work_delayable_from_work(work);
-    struct hold_state *st = CONTAINER_OF(dwork, struct hold_state, release_work);
-
-    if (!st->active) {
-        return;
-    }
+static void release_work_handler(struct zmk_sensor_hold_timer *timer) {
+    struct hold_timer *tm = CONTAINER_OF(timer, struct hold_timer, work);
+    struct behavior_sensor_hold_step_rotate_data *data = tm->dev->data;
 
-    struct zmk_behavior_binding_event ev = {
-        .position = st->last_position,
-        .layer = st->last_layer,
-        .timestamp = (uint32_t)k_uptime_get(),
-    };
+    // timer の添字から sensor / layer を復元
+    const int idx = tm - &data->timer[0][0];
 
-#if IS_ENABLED(CONFIG_ZMK_SPLIT)
-    ev.source = ZMK_POSITION_STATE_CHANGE_SOURCE_LOCAL;
-#endif
-
-    enqueue_release(&ev, st->active_binding);
-    st->active = false;
-    st->step_count = 0;
+    force_release_state(tm->dev, idx / ZMK_KEYMAP_LAYERS_LEN, idx % ZMK_KEYMAP_LAYERS_LEN, false);
 }
 
+#if IS_ENABLED(CONFIG_ZMK_BEHAVIOR_SENSOR_HOLD_STEP_ROTATE_QUICK_RELEASE)
 /* ---- quick-release listener ----
  * 安全化ポイント:
  * - pending_dir は絶対に触らない（accept→process間の競合を避ける）
- * - 未使用インスタンス/未初期化 state は触らない（「存在するだけで副作用」を防ぐ）
  * - active のものだけ解除する（step_count等の副作用を最小に）
  */
 
 static int hold_step_quick_release_listener(const zmk_event_t *eh) {
+    // hold が1つも無ければ何もしない（キー入力ごとの全走査を避ける）
+    if (atomic_get(&active_holds) == 0) {
+        return ZMK_EV_EVENT_BUBBLE;
+    }
+
     const struct zmk_keycode_state_changed *ev = as_zmk_keycode_state_changed(eh);
     if (ev == NULL || !ev->state) {
         return ZMK_EV_EVENT_BUBBLE;
@@ -232,8 +277,6 @@ static int hold_step_quick_release_listener(const zmk_event_t *eh) {
         return ZMK_EV_EVENT_BUBBLE;
     }
 
-    const uint8_t top = (uint8_t)zmk_keymap_highest_layer_active();
-
     for (int di = 0; di < ARRAY_SIZE(devs); di++) {
         const struct device *dev = devs[di];
         const struct behavior_sensor_hold_step_rotate_config *cfg = dev->config;
@@ -244,22 +287,10 @@ static int hold_step_quick_release_listener(const zmk_event_t *eh) {
 
         for (int si = 0; si < ZMK_KEYMAP_SENSORS_LEN; si++) {
             for (int ly = 0; ly < ZMK_KEYMAP_LAYERS_LEN; ly++) {
-                struct hold_state *st = &data->state[si][ly];
-
-                // 未初期化は触らない（未使用インスタンス無害化）
-                if (!st->inited) {
-                    continue;
-                }
-
-                // トップレイヤー限定で、非トップで動いていた hold は解除
-                if (cfg->require_top_layer && st->active && st->last_layer != top) {
-                    force_release_state(cfg, st, true);
-                    continue;
-                }
-
                 // 許可外キー押下で解除：activeだけ対象にする
-                if (st->active) {
-                    force_release_state(cfg, st, true);
+                // （require-top-layer で非トップの hold もここで一緒に解除される）
+                if (data->state[si][ly].active_dir != HOLD_DIR_NONE) {
+                    force_release_state(dev, si, ly, true);
                 }
             }
         }
@@ -270,6 +301,31 @@ static int hold_step_quick_release_listener(const zmk_event_t *eh) {
 
 ZMK_LISTENER(behavior_sensor_hold_step_rotate_quick_release, hold_step_quick_release_listener);
 ZMK_SUBSCRIPTION(behavior_sensor_hold_step_rotate_quick_release, zmk_keycode_state_changed);
+#endif
+
+#if IS_ENABLED(CONFIG_ZMK_SENSOR_HOLD_FLUSH_ON_IDLE)
+/* ---- idle/sleep 前に hold を全部離す ---- */
+
+static int hold_step_activity_listener(const zmk_event_t *eh) {
+    const struct zmk_activity_state_changed *ev = as_zmk_activity_state_changed(eh);
+    if (ev == NULL || ev->state == ZMK_ACTIVITY_ACTIVE || atomic_get(&active_holds) == 0) {
+        return ZMK_EV_EVENT_BUBBLE;
+    }
+
+    for (int di = 0; di < ARRAY_SIZE(devs); di++) {
+        for (int si = 0; si < ZMK_KEYMAP_SENSORS_LEN; si++) {
+            for (int ly = 0; ly < ZMK_KEYMAP_LAYERS_LEN; ly++) {
+                force_release_state(devs[di], si, ly, true);
+            }
+        }
+    }
+
+    return ZMK_EV_EVENT_BUBBLE;
+}
+
+ZMK_LISTENER(behavior_sensor_hold_step_rotate_idle, hold_step_activity_listener);
+ZMK_SUBSCRIPTION(behavior_sensor_hold_step_rotate_idle, zmk_activity_state_changed);
+#endif
 
 /* ---- behavior implementation ---- */
 
@@ -287,10 +343,11 @@ static int accept_data(struct zmk_behavior_binding *binding,
     struct behavior_sensor_hold_step_rotate_data *data = dev->data;
 
     const int sensor_index = ZMK_SENSOR_POSITION_FROM_VIRTUAL_KEY_POSITION(event.position);
+    struct hold_state *st = &data->state[sensor_index][event.layer];
 
     // ★トップレイヤー以外なら状態を残さない
     if (!gate_layer(cfg, (uint8_t)event.layer)) {
-        data->pending_dir[sensor_index][event.layer] = HOLD_DIR_NONE;
+        st->pending_dir = HOLD_DIR_NONE;
         // step_countはprocess側でactiveなら解除するので、ここでは触りすぎない
         return 0;
     }
@@ -299,11 +356,11 @@ static int accept_data(struct zmk_behavior_binding *binding,
     int delta = (v.val1 == 0) ? v.val2 : v.val1;
 
     if (delta > 0) {
-        data->pending_dir[sensor_index][event.layer] = HOLD_DIR_CW;
+        st->pending_dir = HOLD_DIR_CW;
     } else if (delta < 0) {
-        data->pending_dir[sensor_index][event.layer] = HOLD_DIR_CCW;
+        st->pending_dir = HOLD_DIR_CCW;
     } else {
-        data->pending_dir[sensor_index][event.layer] = HOLD_DIR_NONE;
+        st->pending_dir = HOLD_DIR_NONE;
     }
 
     return 0;
@@ -321,22 +378,22 @@ static int process(struct zmk_behavior_binding *binding,
 
     // トップレイヤー以外なら発動しない（activeなら安全解除）
     if (!gate_layer(cfg, (uint8_t)event.layer)) {
-        data->pending_dir[sensor_index][event.layer] = HOLD_DIR_NONE;
+        st->pending_dir = HOLD_DIR_NONE;
 
-        if (st->inited && st->active) {
-            force_release_state(cfg, st, true);
+        if (st->active_dir != HOLD_DIR_NONE) {
+            force_release_state(dev, sensor_index, event.layer, true);
         }
         // ここで OPAQUE にすると他behaviorを殺し得るので TRANSPARENT
         return ZMK_BEHAVIOR_TRANSPARENT;
     }
 
     if (mode != BEHAVIOR_SENSOR_BINDING_PROCESS_MODE_TRIGGER) {
-        data->pending_dir[sensor_index][event.layer] = HOLD_DIR_NONE;
+        st->pending_dir = HOLD_DIR_NONE;
         return ZMK_BEHAVIOR_TRANSPARENT;
     }
 
-    enum hold_dir dir = data->pending_dir[sensor_index][event.layer];
-    data->pending_dir[sensor_index][event.layer] = HOLD_DIR_NONE;
+    uint8_t dir = st->pending_dir;
+    st->pending_dir = HOLD_DIR_NONE;
 
     if (dir == HOLD_DIR_NONE) {
         return ZMK_BEHAVIOR_TRANSPARENT;
@@ -346,72 +403,75 @@ static int process(struct zmk_behavior_binding *binding,
     event.source = ZMK_POSITION_STATE_CHANGE_SOURCE_LOCAL;
 #endif
 
-    // init state（早めに）
-    int64_t now_ms = k_uptime_get();
-    if (!st->inited) {
-        k_work_init_delayable(&st->release_work, release_work_handler);
-        st->inited = true;
-        st->active = false;
-        st->step_count = 0;
-        st->last_dir = HOLD_DIR_NONE;
-        st->last_dir_time_ms = now_ms;
-    }
+#if IS_ENABLED(CONFIG_ZMK_SENSOR_HOLD_CALIBRATION) ||                                              \
+    IS_ENABLED(CONFIG_ZMK_BEHAVIOR_SENSOR_HOLD_STEP_ROTATE_ANTI_REVERSE)
+    // timeout と同じ時計で測る（仮想時計を含む）。event.timestamp は ZMK の sensor event のまま
+    const uint32_t now_ms = (uint32_t)zmk_sensor_hold_now_ms();
+#endif
+
+#if IS_ENABLED(CONFIG_ZMK_SENSOR_HOLD_CALIBRATION)
+    zmk_sensor_hold_cal_record(sensor_index, dir, now_ms, timeout_for(cfg, sensor_index));
+#endif
+
+#if IS_ENABLED(CONFIG_ZMK_BEHAVIOR_SENSOR_HOLD_STEP_ROTATE_ANTI_REVERSE)
+    uint16_t anti_reverse_ms = cfg->anti_reverse_ms;
+#if IS_ENABLED(CONFIG_ZMK_SENSOR_HOLD_CALIBRATION)
+    anti_reverse_ms = zmk_sensor_hold_cal_anti_reverse_ms(sensor_index, anti_reverse_ms);
+#endif
 
     // ---- anti reverse chatter ----
-    if (cfg->anti_reverse_ms > 0 && st->last_dir != HOLD_DIR_NONE) {
-        bool is_reverse = (st->last_dir == HOLD_DIR_CW && dir == HOLD_DIR_CCW) ||
-                          (st->last_dir == HOLD_DIR_CCW && dir == HOLD_DIR_CW);
+    if (anti_reverse_ms > 0 && st->last_dir != HOLD_DIR_NONE) {
+        bool is_reverse = (st->last_dir != dir);
 
-        if (is_reverse && (now_ms - st->last_dir_time_ms) <= cfg->anti_reverse_ms) {
+        if (is_reverse && (uint32_t)(now_ms - st->last_dir_time_ms) <= anti_reverse_ms) {
             // 逆向きの短時間入力は無視して直近方向へ丸める
             dir = st->last_dir;
         }
     }
     st->last_dir = dir;
     st->last_dir_time_ms = now_ms;
+#endif
 
-    struct zmk_behavior_binding hold_next =
-        (dir == HOLD_DIR_CW) ? cfg->hold_cw : cfg->hold_ccw;
-
-    struct zmk_behavior_binding step_binding =
-        (dir == HOLD_DIR_CW) ? cfg->step_cw : cfg->step_ccw;
-
-    st->last_position = event.position;
-    st->last_layer = (uint8_t)event.layer;
-
+#if IS_ENABLED(CONFIG_ZMK_BEHAVIOR_SENSOR_HOLD_STEP_ROTATE_STEP)
     // ---- step (optional) ----
     if (cfg->step_group_size != 0) {
         const uint16_t n = cfg->step_group_size;
-        st->step_count++;
-
-        if (binding_is_valid(step_binding)) {
-            if ((st->step_count % n) == 0) {
-                enqueue_tap(&event, step_binding);
-            }
+        // n ごとに 0 に戻す（% で判定すると uint16_t が1周したところで tap の間隔がずれる）
+        if (++st->step_count >= n) {
+            st->step_count = 0;
+            enqueue_tap(cfg, &event, dir);
         }
     } else {
         // step無効ならカウントも持たない（副作用抑制）
         st->step_count = 0;
     }
+#endif
+
+    struct hold_timer *tm = &data->timer[sensor_index][event.layer];
 
     // ---- hold ----
-    if (!st->active) {
-        st->active = true;
-        st->active_binding = hold_next;
-        enqueue_press(&event, st->active_binding);
-        arm_timeout(cfg, st);
+    /*
+     * timeout は dispatch より先に予約する
+     * - direct-dispatch だと binding がここで同期的に走り、その keycode で quick-release が
+     *   この slot を離して timer を止めることがある。後から予約すると非 active の slot に timer が残る
+     */
+    if (st->active_dir == HOLD_DIR_NONE) {
+        set_active_dir(st, dir);
+        arm_timeout(cfg, tm, sensor_index);
+        enqueue_press(cfg, &event, dir);
         return ZMK_BEHAVIOR_OPAQUE;
     }
 
-    if (cfg->direction_hold_mode == HOLD_MODE_SWITCH) {
-        if (!binding_equal(st->active_binding, hold_next)) {
-            enqueue_release(&event, st->active_binding);
-            st->active_binding = hold_next;
-            enqueue_press(&event, st->active_binding);
-        }
+    arm_timeout(cfg, tm, sensor_index);
+
+    if (cfg->direction_hold_mode == HOLD_MODE_SWITCH && st->active_dir != dir &&
+        !sensor_hold_binding_equal(&cfg->hold[st->active_dir - 1], &cfg->hold[dir - 1])) {
+        const uint8_t prev_dir = st->active_dir;
+        set_active_dir(st, dir);
+        enqueue_release(cfg, &event, prev_dir);
+        enqueue_press(cfg, &event, dir);
     }
 
-    arm_timeout(cfg, st);
     return ZMK_BEHAVIOR_OPAQUE;
 }
 
@@ -421,7 +481,14 @@ static const struct behavior_driver_api api = {
 };
 
 static int init(const struct device *dev) {
-    ARG_UNUSED(dev);
+    struct behavior_sensor_hold_step_rotate_data *data = dev->data;
+
+    for (int si = 0; si < ZMK_KEYMAP_SENSORS_LEN; si++) {
+        for (int ly = 0; ly < ZMK_KEYMAP_LAYERS_LEN; ly++) {
+            zmk_sensor_hold_timer_init(&data->timer[si][ly].work, release_work_handler);
+            data->timer[si][ly].dev = dev;
+        }
+    }
     return 0;
 }
 
@@ -436,6 +503,34 @@ static int init(const struct device *dev) {
                               (DT_INST_PHA_BY_IDX(inst, bindings, idx, param2))),                   \
     }
 
+/*
+ * Kconfig で外した機能のプロパティ
+ * - 3つとも同じ扱い: 無効な値（0 / 未設定）なら無視、機能を使う値を書いていたらビルドエラー
+ * - そのため step-group-size / anti-reverse-ms は yaml に default を持たず、既定値はここで入れる
+ */
+#if IS_ENABLED(CONFIG_ZMK_BEHAVIOR_SENSOR_HOLD_STEP_ROTATE_STEP)
+#define STEP_CFG(n)                                                                                   \
+    .step = {_BINDING_ENTRY(2, n), _BINDING_ENTRY(3, n)},                                              \
+    .step_group_size = DT_INST_PROP_OR(n, step_group_size, 5),
+#define STEP_ASSERT(n)
+#else
+#define STEP_CFG(n)
+#define STEP_ASSERT(n)                                                                                \
+    BUILD_ASSERT(DT_INST_PROP_OR(n, step_group_size, 0) == 0,                                          \
+                 "step-group-size needs CONFIG_ZMK_BEHAVIOR_SENSOR_HOLD_STEP_ROTATE_STEP");
+#endif
+
+#if IS_ENABLED(CONFIG_ZMK_BEHAVIOR_SENSOR_HOLD_STEP_ROTATE_ANTI_REVERSE)
+#define ANTI_REVERSE_CFG(n) .anti_reverse_ms = DT_INST_PROP_OR(n, anti_reverse_ms, 20),
+#define ANTI_REVERSE_ASSERT(n)
+#else
+#define ANTI_REVERSE_CFG(n)
+#define ANTI_REVERSE_ASSERT(n)                                                                        \
+    BUILD_ASSERT(DT_INST_PROP_OR(n, anti_reverse_ms, 0) == 0,                                          \
+                 "anti-reverse-ms needs CONFIG_ZMK_BEHAVIOR_SENSOR_HOLD_STEP_ROTATE_ANTI_REVERSE");
+#endif
+
+#if IS_ENABLED(CONFIG_ZMK_BEHAVIOR_SENSOR_HOLD_STEP_ROTATE_QUICK_RELEASE)
 #define _ALLOW_ITEM(i, inst)                                                                          \
     {                                                                                                 \
         .page = (uint16_t)ZMK_HID_USAGE_PAGE(DT_INST_PROP_BY_IDX(inst, quick_release_allow_list, i)), \
@@ -452,21 +547,33 @@ static int init(const struct device *dev) {
                 (),                                                                                   \
                 (LISTIFY(DT_INST_PROP_LEN(inst, quick_release_allow_list), _ALLOW_ITEM, (,), inst)))
 
+#define QUICK_RELEASE_CFG(n)                                                                          \
+    .quick_release = DT_INST_PROP_OR(n, quick_release, 0),                                             \
+    .allow_count = (uint8_t)ALLOW_COUNT_FROM_INST(n),                                                  \
+    .allow_list = { ALLOW_LIST_FROM_INST(n) },
+#define QUICK_RELEASE_ASSERT(n)
+#else
+#define QUICK_RELEASE_CFG(n)
+#define QUICK_RELEASE_ASSERT(n)                                                                       \
+    BUILD_ASSERT(!DT_INST_PROP_OR(n, quick_release, 0),                                                \
+                 "quick-release needs CONFIG_ZMK_BEHAVIOR_SENSOR_HOLD_STEP_ROTATE_QUICK_RELEASE");
+#endif
+
 #define INST(n)                                                                                       \
+    QUICK_RELEASE_ASSERT(n)                                                                           \
+    STEP_ASSERT(n)                                                                                    \
+    ANTI_REVERSE_ASSERT(n)                                                                            \
+    SENSOR_HOLD_DIRECT_DISPATCH_ASSERT(n)                                                             \
     static struct behavior_sensor_hold_step_rotate_data data_##n = {};                                \
     static const struct behavior_sensor_hold_step_rotate_config cfg_##n = {                           \
-        .hold_cw  = _BINDING_ENTRY(0, n),                                                              \
-        .hold_ccw = _BINDING_ENTRY(1, n),                                                              \
-        .step_cw  = _BINDING_ENTRY(2, n),                                                              \
-        .step_ccw = _BINDING_ENTRY(3, n),                                                              \
+        .hold = {_BINDING_ENTRY(0, n), _BINDING_ENTRY(1, n)},                                          \
+        STEP_CFG(n)                                                                                    \
         .timeout_ms = DT_INST_PROP_OR(n, timeout_ms, 180),                                             \
-        .step_group_size = DT_INST_PROP_OR(n, step_group_size, 5),                                     \
         .direction_hold_mode = DT_INST_PROP_OR(n, direction_hold_mode, 0),                             \
         .require_top_layer = DT_INST_PROP_OR(n, require_top_layer, 1),                                 \
-        .anti_reverse_ms = DT_INST_PROP_OR(n, anti_reverse_ms, 0),                                     \
-        .quick_release = DT_INST_PROP_OR(n, quick_release, 0),                                         \
-        .allow_count = (uint8_t)ALLOW_COUNT_FROM_INST(n),                                              \
-        .allow_list = { ALLOW_LIST_FROM_INST(n) },                                                     \
+        ANTI_REVERSE_CFG(n)                                                                            \
+        .direct_dispatch = DT_INST_PROP_OR(n, direct_dispatch, 0),                                     \
+        QUICK_RELEASE_CFG(n)                                                                           \
     };                                                                                                \
     BEHAVIOR_DT_INST_DEFINE(                                                                           \
         n, init, NULL, &data_##n, &cfg_##n,                                                            \
@@ -0,0 +1,323 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#if IS_ENABLED(CONFIG_SHELL)
+#include <stdlib.h>
+#include <zephyr/shell/shell.h>
+#endif
+
+#include <drivers/behavior.h>
+
+#include <zmk/sensors.h>
+#include <zmk/sensor_hold_calibration.h>
+
+LOG_MODULE_DECLARE(zmk, CONFIG_ZMK_SENSOR_HOLD_LOG_LEVEL);
+
+#ifndef CONFIG_ZMK_SENSOR_HOLD_CALIBRATION_MARGIN_MS
+#define CONFIG_ZMK_SENSOR_HOLD_CALIBRATION_MARGIN_MS 20
+#endif
+
+#ifndef CONFIG_ZMK_SENSOR_HOLD_CALIBRATION_MIN_SAMPLES
+#define CONFIG_ZMK_SENSOR_HOLD_CALIBRATION_MIN_SAMPLES 1000
+#endif
+
+/*
+ * バケット（ms）:
+ * - 0..32   : 2ms 刻み x16
+ * - 32..96  : 8ms 刻み x8
+ * - 96..352 : 32ms 刻み x8
+ * - 352ms 以上は「回し始め」とみなして記録しない
+ * - 同方向 detent 間隔は、その時点の timeout 未満（= hold をつないだもの）だけ記録する。
+ *   timeout を過ぎた間隔は一度離して回し直したもので、含めると p99.9 が上端に張り付く
+ */
+#define CAL_BUCKETS 32
+#define CAL_MAX_GAP_MS 352
+
+struct cal_sensor {
+    uint16_t gap_hist[CAL_BUCKETS];     // 同方向 detent 間隔
+    uint16_t chatter_hist[CAL_BUCKETS]; // A→B→A の B までの間隔
+    uint32_t samples;
+    uint32_t chatter_samples;
+
+    uint32_t last_ms;
+    uint32_t prev_ms;
+    uint8_t last_dir;
+    uint8_t prev_dir;
+
+    // 適用済みの値（0 = 未適用 / devicetree の値を使う）
+    uint16_t timeout_ms;
+    uint16_t anti_reverse_ms;
+};
+
+static struct cal_sensor cal[ZMK_KEYMAP_SENSORS_LEN];
+static struct k_spinlock lock;
+
+static inline int bucket_of(uint32_t gap) {
+    if (gap < 32) {
+        return gap / 2;
+    }
+    if (gap < 96) {
+        return 16 + (gap - 32) / 8;
+    }
+    return 24 + (gap - 96) / 32;
+}
+
+static inline uint16_t bucket_upper_ms(int b) {
+    if (b < 16) {
+        return (b + 1) * 2;
+    }
+    if (b < 24) {
+        return 32 + (b - 16 + 1) * 8;
+    }
+    return 96 + (b - 24 + 1) * 32;
+}
+
+// uint16 が溢れそうになったら全体を半分にする（分布の形は保つ）
+static void hist_add(uint16_t *hist, int b) {
+    if (hist[b] == UINT16_MAX) {
+        for (int i = 0; i < CAL_BUCKETS; i++) {
+            hist[i] /= 2;
+        }
+    }
+    hist[b]++;
+}
+
+// permille: 999 => p99.9。該当バケットの上端を返す（空なら 0）
+static uint16_t hist_percentile(const uint16_t *hist, uint32_t permille) {
+    uint32_t total = 0;
+    for (int i = 0; i < CAL_BUCKETS; i++) {
+        total += hist[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    const uint32_t target = (total * permille) / 1000;
+    uint32_t acc = 0;
+    for (int i = 0; i < CAL_BUCKETS; i++) {
+        acc += hist[i];
+        if (acc > target) {
+            return bucket_upper_ms(i);
+        }
+    }
+    return bucket_upper_ms(CAL_BUCKETS - 1);
+}
+
+static inline bool valid_sensor(int sensor_index) {
+    return sensor_index >= 0 && sensor_index < ZMK_KEYMAP_SENSORS_LEN;
+}
+
+void zmk_sensor_hold_cal_record(int sensor_index, uint8_t dir, uint32_t now_ms,
+                                uint16_t timeout_ms) {
+    if (!valid_sensor(sensor_index)) {
+        return;
+    }
+
+    bool due = false;
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    struct cal_sensor *c = &cal[sensor_index];
+    const uint32_t gap = now_ms - c->last_ms;
+
+    if (c->last_dir == dir) {
+        if (gap < timeout_ms && gap < CAL_MAX_GAP_MS) {
+            hist_add(c->gap_hist, bucket_of(gap));
+            c->samples++;
+            // この呼び出しで MIN_SAMPLES の倍数に達したときだけ（逆回転や hold が切れた gap では数えない）
+            due = (c->samples % CONFIG_ZMK_SENSOR_HOLD_CALIBRATION_MIN_SAMPLES) == 0;
+        }
+    } else if (c->last_dir != 0 && c->prev_dir == dir) {
+        // A→B→A: 直前の B は1発だけの逆回転（チャタリング）
+        const uint32_t blip = c->last_ms - c->prev_ms;
+        if (blip < CAL_MAX_GAP_MS) {
+            hist_add(c->chatter_hist, bucket_of(blip));
+            c->chatter_samples++;
+        }
+    }
+
+    c->prev_dir = c->last_dir;
+    c->prev_ms = c->last_ms;
+    c->last_dir = dir;
+    c->last_ms = now_ms;
+    k_spin_unlock(&lock, key);
+
+#if IS_ENABLED(CONFIG_ZMK_SENSOR_HOLD_CALIBRATION_AUTO_APPLY)
+    if (due) {
+        zmk_sensor_hold_cal_apply(sensor_index);
+    }
+#else
+    ARG_UNUSED(due);
+#endif
+}
+
+int zmk_sensor_hold_cal_recommend(int sensor_index,
+                                  struct zmk_sensor_hold_cal_recommendation *out) {
+    if (!valid_sensor(sensor_index)) {
+        return -EINVAL;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    const struct cal_sensor *c = &cal[sensor_index];
+
+    out->samples = c->samples;
+    out->chatter_samples = c->chatter_samples;
+    out->timeout_ms = 0;
+    out->anti_reverse_ms = 0;
+
+    if (c->samples >= CONFIG_ZMK_SENSOR_HOLD_CALIBRATION_MIN_SAMPLES) {
+        out->timeout_ms =
+            hist_percentile(c->gap_hist, 999) + CONFIG_ZMK_SENSOR_HOLD_CALIBRATION_MARGIN_MS;
+    }
+    // 数発のチャタリングで窓を決めると1発の偶然で本当の反転を飲み込むので、timeout と同じ数を待つ
+    if (c->chatter_samples >= CONFIG_ZMK_SENSOR_HOLD_CALIBRATION_MIN_SAMPLES) {
+        // 逆向き入力を丸める窓なので margin は控えめ（timeout の 1/4）
+        out->anti_reverse_ms = hist_percentile(c->chatter_hist, 990) +
+                               CONFIG_ZMK_SENSOR_HOLD_CALIBRATION_MARGIN_MS / 4;
+    }
+    k_spin_unlock(&lock, key);
+
+    return 0;
+}
+
+int zmk_sensor_hold_cal_apply(int sensor_index) {
+    struct zmk_sensor_hold_cal_recommendation rec;
+    int ret = zmk_sensor_hold_cal_recommend(sensor_index, &rec);
+    if (ret < 0) {
+        return ret;
+    }
+    if (rec.timeout_ms == 0) {
+        return -EAGAIN;
+    }
+
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    cal[sensor_index].timeout_ms = rec.timeout_ms;
+    cal[sensor_index].anti_reverse_ms = rec.anti_reverse_ms;
+    k_spin_unlock(&lock, key);
+
+    LOG_INF("hold_cal sensor=%d apply timeout=%d anti_reverse=%d (n=%u)", sensor_index,
+            rec.timeout_ms, rec.anti_reverse_ms, rec.samples);
+    return 0;
+}
+
+void zmk_sensor_hold_cal_clear(int sensor_index) {
+    if (!valid_sensor(sensor_index)) {
+        return;
+    }
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    cal[sensor_index].timeout_ms = 0;
+    cal[sensor_index].anti_reverse_ms = 0;
+    k_spin_unlock(&lock, key);
+}
+
+void zmk_sensor_hold_cal_reset(int sensor_index) {
+    if (!valid_sensor(sensor_index)) {
+        return;
+    }
+    k_spinlock_key_t key = k_spin_lock(&lock);
+    struct cal_sensor *c = &cal[sensor_index];
+    const uint16_t timeout_ms = c->timeout_ms;
+    const uint16_t anti_reverse_ms = c->anti_reverse_ms;
+    *c = (struct cal_sensor){
+        .timeout_ms = timeout_ms,
+        .anti_reverse_ms = anti_reverse_ms,
+    };
+    k_spin_unlock(&lock, key);
+}
+
+uint16_t zmk_sensor_hold_cal_timeout_ms(int sensor_index, uint16_t configured) {
+    if (!valid_sensor(sensor_index) || cal[sensor_index].timeout_ms == 0) {
+        return configured;
+    }
+    return cal[sensor_index].timeout_ms;
+}
+
+uint16_t zmk_sensor_hold_cal_anti_reverse_ms(int sensor_index, uint16_t configured) {
+    // devicetree で 0（無効）にした instance はそのまま。チャタリングが足りなければ devicetree の値
+    if (configured == 0 || !valid_sensor(sensor_index) ||
+        cal[sensor_index].anti_reverse_ms == 0) {
+        return configured;
+    }
+    return cal[sensor_index].anti_reverse_ms;
+}
+
+/* ---- shell: hold_cal show|apply|clear|reset [sensor] ---- */
+#if IS_ENABLED(CONFIG_SHELL)
+
+typedef void (*cal_fn)(const struct shell *sh, int sensor_index);
+
+static int for_each_sensor(const struct shell *sh, size_t argc, char **argv, cal_fn fn) {
+    if (argc > 1) {
+        const int sensor_index = atoi(argv[1]);
+        if (!valid_sensor(sensor_index)) {
+            shell_error(sh, "invalid sensor %s", argv[1]);
+            return -EINVAL;
+        }
+        fn(sh, sensor_index);
+        return 0;
+    }
+    for (int i = 0; i < ZMK_KEYMAP_SENSORS_LEN; i++) {
+        fn(sh, i);
+    }
+    return 0;
+}
+
+static void show_one(const struct shell *sh, int sensor_index) {
+    struct zmk_sensor_hold_cal_recommendation rec;
+    zmk_sensor_hold_cal_recommend(sensor_index, &rec);
+    shell_print(sh, "sensor %d: gaps=%u chatter=%u -> timeout-ms=%d anti-reverse-ms=%d%s",
+                sensor_index, rec.samples, rec.chatter_samples, rec.timeout_ms,
+                rec.anti_reverse_ms,
+                cal[sensor_index].timeout_ms ? " (applied)" : "");
+}
+
+static void apply_one(const struct shell *sh, int sensor_index) {
+    if (zmk_sensor_hold_cal_apply(sensor_index) < 0) {
+        shell_warn(sh, "sensor %d: not enough samples", sensor_index);
+        return;
+    }
+    show_one(sh, sensor_index);
+}
+
+static void clear_one(const struct shell *sh, int sensor_index) {
+    ARG_UNUSED(sh);
+    zmk_sensor_hold_cal_clear(sensor_index);
+}
+
+static void reset_one(const struct shell *sh, int sensor_index) {
+    ARG_UNUSED(sh);
+    zmk_sensor_hold_cal_reset(sensor_index);
+}
+
+static int cmd_show(const struct shell *sh, size_t argc, char **argv) {
+    return for_each_sensor(sh, argc, argv, show_one);
+}
+
+static int cmd_apply(const struct shell *sh, size_t argc, char **argv) {
+    return for_each_sensor(sh, argc, argv, apply_one);
+}
+
+static int cmd_clear(const struct shell *sh, size_t argc, char **argv) {
+    return for_each_sensor(sh, argc, argv, clear_one);
+}
+
+static int cmd_reset(const struct shell *sh, size_t argc, char **argv) {
+    return for_each_sensor(sh, argc, argv, reset_one);
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_hold_cal,
+                               SHELL_CMD_ARG(show, NULL, "Show recommendations [sensor]", cmd_show,
+                                             1, 1),
+                               SHELL_CMD_ARG(apply, NULL, "Apply recommendations [sensor]",
+                                             cmd_apply, 1, 1),
+                               SHELL_CMD_ARG(clear, NULL, "Back to devicetree values [sensor]",
+                                             cmd_clear, 1, 1),
+                               SHELL_CMD_ARG(reset, NULL, "Drop recorded histograms [sensor]",
+                                             cmd_reset, 1, 1),
+                               SHELL_SUBCMD_SET_END);
+
+SHELL_CMD_REGISTER(hold_cal, &sub_hold_cal, "Sensor hold timeout calibration", NULL);
+
+#endif
@@ -0,0 +1,151 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/slist.h>
+
+#include <zmk/behavior.h>
+#include <zmk/sensor_hold_clock.h>
+
+#if IS_ENABLED(CONFIG_ZMK_SENSOR_HOLD_VIRTUAL_CLOCK)
+
+/*
+ * 仮想時計
+ * - timer は init 時に全部リストへ登録（数は sensor x layer 程度なので線形で十分）
+ * - 発火は advance() を呼んだスレッドで同期的に行う
+ */
+static int64_t virtual_now_ms;
+static uint32_t wakeups;
+static sys_slist_t timers = SYS_SLIST_STATIC_INIT(&timers);
+
+void zmk_sensor_hold_timer_init(struct zmk_sensor_hold_timer *timer,
+                                zmk_sensor_hold_timer_handler_t handler) {
+    timer->handler = handler;
+    timer->armed = false;
+    sys_slist_append(&timers, &timer->node);
+}
+
+int64_t zmk_sensor_hold_now_ms(void) { return virtual_now_ms; }
+
+void zmk_sensor_hold_timer_start(struct zmk_sensor_hold_timer *timer, uint32_t ms) {
+    timer->deadline_ms = virtual_now_ms + ms;
+    timer->armed = true;
+}
+
+void zmk_sensor_hold_timer_schedule(struct zmk_sensor_hold_timer *timer, uint32_t ms) {
+    if (!timer->armed) {
+        zmk_sensor_hold_timer_start(timer, ms);
+    }
+}
+
+void zmk_sensor_hold_timer_stop(struct zmk_sensor_hold_timer *timer) { timer->armed = false; }
+
+void zmk_sensor_hold_clock_set(int64_t now_ms) { virtual_now_ms = now_ms; }
+
+static struct zmk_sensor_hold_timer *next_expired(int64_t until_ms) {
+    struct zmk_sensor_hold_timer *next = NULL;
+    struct zmk_sensor_hold_timer *timer;
+
+    SYS_SLIST_FOR_EACH_CONTAINER(&timers, timer, node) {
+        if (!timer->armed || timer->deadline_ms > until_ms) {
+            continue;
+        }
+        if (next == NULL || timer->deadline_ms < next->deadline_ms) {
+            next = timer;
+        }
+    }
+    return next;
+}
+
+void zmk_sensor_hold_clock_advance(uint32_t ms) {
+    const int64_t until_ms = virtual_now_ms + ms;
+    struct zmk_sensor_hold_timer *timer;
+
+    while ((timer = next_expired(until_ms)) != NULL) {
+        virtual_now_ms = timer->deadline_ms;
+        timer->armed = false;
+        wakeups++;
+        timer->handler(timer);
+    }
+    virtual_now_ms = until_ms;
+}
+
+uint32_t zmk_sensor_hold_clock_wakeups(void) { return wakeups; }
+
+int zmk_sensor_hold_clock_armed(void) {
+    struct zmk_sensor_hold_timer *timer;
+    int armed = 0;
+
+    SYS_SLIST_FOR_EACH_CONTAINER(&timers, timer, node) {
+        armed += timer->armed;
+    }
+    return armed;
+}
+
+/*
+ * 仮想 behavior queue
+ * - ZMK の behavior_queue.c と同じく、取り出してから binding を呼ぶ
+ *   （呼んでいる間に積まれた item は同じループで後から処理され、その間 idle にはならない）
+ * - k_work を挟まないので、遷移の順序とタイミングは呼び出し側だけで決まる
+ */
+#define VIRTUAL_QUEUE_LEN 64
+
+struct virtual_queue_item {
+    struct zmk_behavior_binding_event event;
+    struct zmk_behavior_binding binding;
+    bool pressed;
+};
+
+static struct virtual_queue_item queue[VIRTUAL_QUEUE_LEN];
+static uint8_t queue_head;
+static uint8_t queue_len;
+static bool queue_running;
+
+bool zmk_sensor_hold_queue_idle(void) { return queue_len == 0; }
+
+int zmk_sensor_hold_queue_add(const struct zmk_behavior_binding_event *event,
+                              const struct zmk_behavior_binding *binding, bool pressed) {
+    if (queue_len == VIRTUAL_QUEUE_LEN) {
+        return -ENOMSG;
+    }
+
+    queue[(queue_head + queue_len) % VIRTUAL_QUEUE_LEN] = (struct virtual_queue_item){
+        .event = *event,
+        .binding = *binding,
+        .pressed = pressed,
+    };
+    queue_len++;
+
+    if (queue_running) {
+        return 0;
+    }
+
+    queue_running = true;
+    while (queue_len > 0) {
+        struct virtual_queue_item item = queue[queue_head];
+
+        queue_head = (queue_head + 1) % VIRTUAL_QUEUE_LEN;
+        queue_len--;
+        zmk_behavior_invoke_binding(&item.binding, item.event, item.pressed);
+    }
+    queue_running = false;
+    return 0;
+}
+
+#else
+
+static void timer_work_handler(struct k_work *work) {
+    struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+    struct zmk_sensor_hold_timer *timer = CONTAINER_OF(dwork, struct zmk_sensor_hold_timer, work);
+
+    timer->handler(timer);
+}
+
+void zmk_sensor_hold_timer_init(struct zmk_sensor_hold_timer *timer,
+                                zmk_sensor_hold_timer_handler_t handler) {
+    timer->handler = handler;
+    k_work_init_delayable(&timer->work, timer_work_handler);
+}
+
+#endif
@@ -0,0 +1,94 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+/*
+ * sensor hold 系 behavior（hold-rotate / hold-step-rotate）の共通部品
+ * - モジュール内部用。各 .c から include して static inline で使う
+ */
+
+#include <zephyr/kernel.h>
+
+#include <drivers/behavior.h>
+
+#include <zmk/behavior.h>
+#include <zmk/refcount_key.h>
+#include <zmk/sensor_hold_clock.h>
+
+enum hold_dir {
+    HOLD_DIR_NONE = 0,
+    HOLD_DIR_CW = 1,
+    HOLD_DIR_CCW = 2,
+};
+
+/*
+ * active hold 数の管理
+ * - counter はインスタンス合計（behavior ごとに1つ）
+ * - 0 の間は timer を1つも予約していない（idle 中の wakeup ゼロ）。listener はこれを見て即 return する
+ */
+static inline void sensor_hold_set_active(atomic_t *active_holds, uint8_t *active_dir, uint8_t dir) {
+    if (*active_dir == HOLD_DIR_NONE && dir != HOLD_DIR_NONE) {
+        atomic_inc(active_holds);
+    } else if (*active_dir != HOLD_DIR_NONE && dir == HOLD_DIR_NONE) {
+        atomic_dec(active_holds);
+    }
+    *active_dir = dir;
+}
+
+#if IS_ENABLED(CONFIG_ZMK_SENSOR_HOLD_DIRECT_DISPATCH)
+/*
+ * behavior queue が空か（direct-dispatch 用）
+ * - ZMK の公開 API に空判定が無いので app/src/behavior_queue.c の msgq（非公開シンボル）を直接見る。
+ *   ZMK 側の実装が変わるとリンクで落ちるので Kconfig で opt-in にしている
+ * - 仮想時計では仮想 queue を見る
+ */
+#if IS_ENABLED(CONFIG_ZMK_SENSOR_HOLD_VIRTUAL_CLOCK)
+static inline bool sensor_hold_queue_idle(void) { return zmk_sensor_hold_queue_idle(); }
+#else
+extern struct k_msgq zmk_behavior_queue_msgq;
+
+static inline bool sensor_hold_queue_idle(void) {
+    return k_msgq_num_used_get(&zmk_behavior_queue_msgq) == 0;
+}
+#endif
+
+#define SENSOR_HOLD_DIRECT_DISPATCH_ASSERT(n)
+#else
+#define SENSOR_HOLD_DIRECT_DISPATCH_ASSERT(n)                                                      \
+    BUILD_ASSERT(!DT_INST_PROP_OR(n, direct_dispatch, 0),                                          \
+                 "direct-dispatch needs CONFIG_ZMK_SENSOR_HOLD_DIRECT_DISPATCH");
+#endif
+
+/*
+ * hold / tap の遷移を出す
+ * - &kp は共有 refcount テーブル経由にして、物理キーと同じ keycode の重複遷移を抑える
+ * - direct-dispatch: wait=0 の queue を通さずにその場で binding を呼ぶ。ただし
+ *   ISR 内、または behavior queue に未処理の item がある間は queue に回す
+ *   （macro や他の behavior が積んだ遷移を追い越さないため）
+ * - queue が空のときだけ直接呼ぶので、同じインスタンスの遷移の順序も崩れない
+ */
+static inline int sensor_hold_dispatch(bool direct_dispatch, struct zmk_behavior_binding_event *event,
+                                       const struct zmk_behavior_binding *binding, bool pressed) {
+#if IS_ENABLED(CONFIG_ZMK_REFCOUNT_KEY_ROUTE_KP)
+    struct zmk_behavior_binding routed = *binding;
+    if (zmk_refcount_key_route_binding(&routed)) {
+        binding = &routed;
+    }
+#endif
+#if IS_ENABLED(CONFIG_ZMK_SENSOR_HOLD_DIRECT_DISPATCH)
+    if (direct_dispatch && !k_is_in_isr() && sensor_hold_queue_idle()) {
+        return zmk_behavior_invoke_binding(binding, *event, pressed);
+    }
+#else
+    ARG_UNUSED(direct_dispatch);
+#endif
+    return zmk_sensor_hold_queue_add(event, binding, pressed);
+}
+
+static inline bool sensor_hold_binding_equal(const struct zmk_behavior_binding *a,
+                                             const struct zmk_behavior_binding *b) {
+    return (a->behavior_dev == b->behavior_dev) && (a->param1 == b->param1) &&
+           (a->param2 == b->param2);
+}
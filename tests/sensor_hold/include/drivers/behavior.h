@@ -0,0 +1,38 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+/* test fake: ZMK の drivers/behavior.h（モジュールが使う分だけ） */
+
+#include <stddef.h>
+
+#include <zephyr/device.h>
+
+#include <zmk/behavior.h>
+#include <zmk/sensors.h>
+
+enum behavior_sensor_binding_process_mode {
+    BEHAVIOR_SENSOR_BINDING_PROCESS_MODE_TRIGGER,
+    BEHAVIOR_SENSOR_BINDING_PROCESS_MODE_DISCARD,
+};
+
+typedef int (*behavior_keymap_binding_callback_t)(struct zmk_behavior_binding *binding,
+                                                  struct zmk_behavior_binding_event event);
+typedef int (*behavior_sensor_keymap_binding_process_callback_t)(
+    struct zmk_behavior_binding *binding, struct zmk_behavior_binding_event event,
+    enum behavior_sensor_binding_process_mode mode);
+typedef int (*behavior_sensor_keymap_binding_accept_data_callback_t)(
+    struct zmk_behavior_binding *binding, struct zmk_behavior_binding_event event,
+    const struct zmk_sensor_config *sensor_config, size_t channel_data_size,
+    const struct zmk_sensor_channel_data *channel_data);
+
+struct behavior_driver_api {
+    behavior_keymap_binding_callback_t binding_pressed;
+    behavior_keymap_binding_callback_t binding_released;
+    behavior_sensor_keymap_binding_accept_data_callback_t sensor_binding_accept_data;
+    behavior_sensor_keymap_binding_process_callback_t sensor_binding_process;
+};
+
+#define BEHAVIOR_DT_INST_DEFINE(inst, ...) DEVICE_DT_INST_DEFINE(inst, __VA_ARGS__)
@@ -0,0 +1,48 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+/*
+ * テスト用の keycode（devicetree overlay と main.c で共有）
+ * - ZMK の encoded usage と同じ形（page << 16 | id）。page 0x07 = keyboard
+ */
+#define TEST_KEY(id) ((0x07 << 16) | (id))
+
+/* hold-rotate: group メンバー */
+#define K_L_CW TEST_KEY(0x04)
+#define K_L_CCW TEST_KEY(0x05)
+#define K_R_CW TEST_KEY(0x06)
+#define K_R_CCW TEST_KEY(0x07)
+/* group の chord: [CW,CW] [CW,CCW] [CCW,CW] [CCW,CCW] */
+#define K_CHORD_0 TEST_KEY(0x08)
+#define K_CHORD_1 TEST_KEY(0x09)
+#define K_CHORD_2 TEST_KEY(0x0A)
+#define K_CHORD_3 TEST_KEY(0x0B)
+
+/* hold-rotate: 単独（physical key と keycode を共有して refcount を見る） */
+#define K_VOL_UP TEST_KEY(0x80)
+#define K_VOL_DN TEST_KEY(0x81)
+
+/* hold-step-rotate */
+#define K_UP TEST_KEY(0x52)
+#define K_DOWN TEST_KEY(0x51)
+#define K_PG_UP TEST_KEY(0x4B)
+#define K_PG_DN TEST_KEY(0x4E)
+
+/* physical key 用 */
+#define K_OTHER TEST_KEY(0x0C)
+#define K_ALLOWED TEST_KEY(0x0D)
+#define K_LSHIFT TEST_KEY(0xE1)
+
+/* sensor / timeout（overlay と期待値で共有） */
+#define TEST_SENSOR_HR 0
+#define TEST_SENSOR_HSR 1
+#define TEST_HR_TIMEOUT_MS 100
+#define TEST_HR_L_TIMEOUT_MS 100
+#define TEST_HR_R_TIMEOUT_MS 150
+#define TEST_HSR_TIMEOUT_MS 120
+#define TEST_CHORD_WINDOW_MS 30
+#define TEST_STEP_GROUP_SIZE 3
+#define TEST_ANTI_REVERSE_MS 20
@@ -0,0 +1,11 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+enum zmk_activity_state {
+    ZMK_ACTIVITY_ACTIVE,
+    ZMK_ACTIVITY_IDLE,
+    ZMK_ACTIVITY_SLEEP,
+};
@@ -0,0 +1,32 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+/* test fake: ZMK の zmk/behavior.h（モジュールが使う分だけ） */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <zephyr/device.h>
+
+#define ZMK_BEHAVIOR_OPAQUE 0
+#define ZMK_BEHAVIOR_TRANSPARENT 1
+
+struct zmk_behavior_binding {
+    const char *behavior_dev;
+    uint32_t param1;
+    uint32_t param2;
+};
+
+struct zmk_behavior_binding_event {
+    int layer;
+    uint32_t position;
+    int64_t timestamp;
+};
+
+const struct device *zmk_behavior_get_binding(const char *name);
+
+int zmk_behavior_invoke_binding(const struct zmk_behavior_binding *src_binding,
+                                struct zmk_behavior_binding_event event, bool pressed);
@@ -0,0 +1,12 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+/* test fake: 仮想時計のビルドでは sensor_hold_clock の同期 queue を使うので宣言だけ */
+
+#include <zmk/behavior.h>
+
+int zmk_behavior_queue_add(const struct zmk_behavior_binding_event *event,
+                           const struct zmk_behavior_binding binding, bool press, uint32_t wait);
@@ -0,0 +1,33 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+/*
+ * test fake: ZMK の event manager の最小版
+ * - event は種類と中身のポインタだけ
+ * - ZMK_LISTENER は既知の名前の関数を定義し、fake_zmk.c が raise のたびに全部呼ぶ
+ *   （listener 側は as_zmk_*() で自分の event 以外を捨てるので subscription は不要）
+ */
+
+enum zmk_fake_event_type {
+    ZMK_FAKE_EVENT_KEYCODE_STATE_CHANGED,
+    ZMK_FAKE_EVENT_POSITION_STATE_CHANGED,
+    ZMK_FAKE_EVENT_ACTIVITY_STATE_CHANGED,
+};
+
+typedef struct {
+    enum zmk_fake_event_type type;
+    const void *data;
+} zmk_event_t;
+
+#define ZMK_EV_EVENT_BUBBLE 0
+#define ZMK_EV_EVENT_HANDLED 1
+#define ZMK_EV_EVENT_CAPTURED 2
+
+#define ZMK_LISTENER(mod, cb)                                                                      \
+    int zmk_fake_listener_##mod(const zmk_event_t *eh) { return cb(eh); }                          \
+    extern int zmk_fake_listener_##mod(const zmk_event_t *eh)
+
+#define ZMK_SUBSCRIPTION(mod, ev_type) extern int zmk_fake_listener_##mod(const zmk_event_t *eh)
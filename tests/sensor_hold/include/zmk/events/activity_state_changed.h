@@ -0,0 +1,16 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <zmk/activity.h>
+#include <zmk/event_manager.h>
+
+struct zmk_activity_state_changed {
+    enum zmk_activity_state state;
+};
+
+const struct zmk_activity_state_changed *as_zmk_activity_state_changed(const zmk_event_t *eh);
+
+int raise_zmk_activity_state_changed(struct zmk_activity_state_changed ev);
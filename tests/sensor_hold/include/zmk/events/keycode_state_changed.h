@@ -0,0 +1,24 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <zmk/event_manager.h>
+
+struct zmk_keycode_state_changed {
+    uint16_t usage_page;
+    uint32_t keycode;
+    uint8_t implicit_modifiers;
+    uint8_t explicit_modifiers;
+    bool state;
+    int64_t timestamp;
+};
+
+const struct zmk_keycode_state_changed *as_zmk_keycode_state_changed(const zmk_event_t *eh);
+
+int raise_zmk_keycode_state_changed_from_encoded(uint32_t encoded, bool pressed,
+                                                 int64_t timestamp);
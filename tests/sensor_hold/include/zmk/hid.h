@@ -0,0 +1,9 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+/* test fake: HID report は fake_zmk.c が keycode_state_changed から記録する */
+
+#include <zmk/keys.h>
@@ -0,0 +1,11 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+/* test fake: layer は2つ。最上位 layer はテストから fake_zmk_set_highest_layer() で変える */
+
+#define ZMK_KEYMAP_LAYERS_LEN 2
+
+int zmk_keymap_highest_layer_active(void);
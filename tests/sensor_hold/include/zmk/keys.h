@@ -0,0 +1,19 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* test fake: ZMK の encoded usage（page << 16 | id）と is_mod() */
+
+#define ZMK_HID_USAGE_ID(usage) ((usage) & 0xFFFF)
+#define ZMK_HID_USAGE_PAGE(usage) (((usage) >> 16) & 0xFF)
+
+#define HID_USAGE_KEY 0x07
+
+static inline bool is_mod(uint8_t usage_page, uint32_t keycode) {
+    return usage_page == HID_USAGE_KEY && keycode >= 0xE0 && keycode <= 0xE7;
+}
@@ -0,0 +1,8 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+/* test fake: 物理キーは8個（position 0..7）、sensor の virtual position はその後ろ */
+#define ZMK_KEYMAP_LEN 8
@@ -0,0 +1,20 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+/* test fake: ZMK の zmk/sensors.h。sensor は2つ（TEST_SENSOR_HR / TEST_SENSOR_HSR） */
+
+#include <zephyr/drivers/sensor.h>
+
+#define ZMK_KEYMAP_SENSORS_LEN 2
+
+struct zmk_sensor_config {
+    uint16_t triggers_per_rotation;
+};
+
+struct zmk_sensor_channel_data {
+    enum sensor_channel channel;
+    struct sensor_value value;
+};
@@ -0,0 +1,11 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <zmk/matrix.h>
+#include <zmk/sensors.h>
+
+#define ZMK_VIRTUAL_KEY_POSITION_SENSOR(index) (ZMK_KEYMAP_LEN + (index))
+#define ZMK_SENSOR_POSITION_FROM_VIRTUAL_KEY_POSITION(index) ((index) - ZMK_KEYMAP_LEN)
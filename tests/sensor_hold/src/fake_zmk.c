@@ -0,0 +1,249 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#define DT_DRV_COMPAT zmk_behavior_key_press
+
+#include <zephyr/device.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include <drivers/behavior.h>
+
+#include <zmk/behavior.h>
+#include <zmk/keys.h>
+#include <zmk/keymap.h>
+#include <zmk/virtual_key_position.h>
+#include <zmk/sensor_hold_clock.h>
+#include <zmk/events/activity_state_changed.h>
+#include <zmk/events/keycode_state_changed.h>
+#include <zmk/events/position_state_changed.h>
+
+#include "fake_zmk.h"
+
+LOG_MODULE_REGISTER(zmk, CONFIG_ZMK_LOG_LEVEL);
+
+/* ---- event manager ---- */
+
+/*
+ * モジュールの listener（ZMK_LISTENER の名前）
+ * - Kconfig で外れた listener は weak の空実装が残る
+ * - 呼ぶ順は ZMK と同じく登録順に依存しない前提
+ */
+#define FAKE_LISTENERS(X)                                                                          \
+    X(behavior_refcount_key_watchdog)                                                              \
+    X(behavior_sensor_hold_rotate_idle)                                                            \
+    X(behavior_sensor_hold_step_rotate_quick_release)                                              \
+    X(behavior_sensor_hold_step_rotate_idle)
+
+#define WEAK_LISTENER(mod)                                                                         \
+    __weak int zmk_fake_listener_##mod(const zmk_event_t *eh) {                                    \
+        ARG_UNUSED(eh);                                                                            \
+        return ZMK_EV_EVENT_BUBBLE;                                                                \
+    }
+FAKE_LISTENERS(WEAK_LISTENER)
+
+static void dispatch_event(enum zmk_fake_event_type type, const void *data) {
+    const zmk_event_t eh = {.type = type, .data = data};
+
+#define CALL_LISTENER(mod) (void)zmk_fake_listener_##mod(&eh);
+    FAKE_LISTENERS(CALL_LISTENER)
+#undef CALL_LISTENER
+}
+
+#define AS_EVENT(name, type_id)                                                                    \
+    const struct zmk_##name *as_zmk_##name(const zmk_event_t *eh) {                                \
+        return (eh->type == type_id) ? eh->data : NULL;                                            \
+    }
+
+AS_EVENT(keycode_state_changed, ZMK_FAKE_EVENT_KEYCODE_STATE_CHANGED)
+AS_EVENT(position_state_changed, ZMK_FAKE_EVENT_POSITION_STATE_CHANGED)
+AS_EVENT(activity_state_changed, ZMK_FAKE_EVENT_ACTIVITY_STATE_CHANGED)
+
+/* ---- HID ---- */
+
+#define FAKE_HID_KEYS 32
+
+static struct fake_hid_report hid_log[FAKE_HID_LOG_LEN];
+static size_t hid_reports;
+static uint32_t hid_errors;
+static uint32_t hid_pressed[FAKE_HID_KEYS];
+static size_t hid_pressed_len;
+
+static int pressed_index(uint32_t encoded) {
+    for (size_t i = 0; i < hid_pressed_len; i++) {
+        if (hid_pressed[i] == encoded) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void hid_record(uint32_t encoded, bool pressed, int64_t timestamp) {
+    hid_log[hid_reports % FAKE_HID_LOG_LEN] = (struct fake_hid_report){
+        .timestamp = timestamp,
+        .encoded = encoded,
+        .pressed = pressed,
+    };
+    hid_reports++;
+
+    const int idx = pressed_index(encoded);
+    if (pressed) {
+        if (idx >= 0 || hid_pressed_len == FAKE_HID_KEYS) {
+            hid_errors++;
+            return;
+        }
+        hid_pressed[hid_pressed_len++] = encoded;
+    } else {
+        if (idx < 0) {
+            hid_errors++;
+            return;
+        }
+        hid_pressed[idx] = hid_pressed[--hid_pressed_len];
+    }
+}
+
+size_t fake_hid_report_count(void) { return hid_reports; }
+
+const struct fake_hid_report *fake_hid_report(size_t index) {
+    if (index >= hid_reports || hid_reports - index > FAKE_HID_LOG_LEN) {
+        return NULL;
+    }
+    return &hid_log[index % FAKE_HID_LOG_LEN];
+}
+
+bool fake_hid_is_pressed(uint32_t encoded) { return pressed_index(encoded) >= 0; }
+
+size_t fake_hid_pressed_count(void) { return hid_pressed_len; }
+
+uint32_t fake_hid_errors(void) { return hid_errors; }
+
+int raise_zmk_keycode_state_changed_from_encoded(uint32_t encoded, bool pressed,
+                                                 int64_t timestamp) {
+    const struct zmk_keycode_state_changed ev = {
+        .usage_page = ZMK_HID_USAGE_PAGE(encoded),
+        .keycode = ZMK_HID_USAGE_ID(encoded),
+        .state = pressed,
+        .timestamp = timestamp,
+    };
+
+    hid_record(encoded, pressed, timestamp);
+    dispatch_event(ZMK_FAKE_EVENT_KEYCODE_STATE_CHANGED, &ev);
+    return 0;
+}
+
+int raise_zmk_position_state_changed(struct zmk_position_state_changed ev) {
+    dispatch_event(ZMK_FAKE_EVENT_POSITION_STATE_CHANGED, &ev);
+    return 0;
+}
+
+int raise_zmk_activity_state_changed(struct zmk_activity_state_changed ev) {
+    dispatch_event(ZMK_FAKE_EVENT_ACTIVITY_STATE_CHANGED, &ev);
+    return 0;
+}
+
+/* ---- keymap / behavior ---- */
+
+static int highest_layer;
+
+int zmk_keymap_highest_layer_active(void) { return highest_layer; }
+
+void fake_zmk_set_highest_layer(int layer) { highest_layer = layer; }
+
+const struct device *zmk_behavior_get_binding(const char *name) {
+    return device_get_binding(name);
+}
+
+int zmk_behavior_invoke_binding(const struct zmk_behavior_binding *src_binding,
+                                struct zmk_behavior_binding_event event, bool pressed) {
+    const struct device *dev = zmk_behavior_get_binding(src_binding->behavior_dev);
+    if (dev == NULL) {
+        return -ENODEV;
+    }
+
+    const struct behavior_driver_api *api = dev->api;
+    struct zmk_behavior_binding binding = *src_binding;
+    behavior_keymap_binding_callback_t cb = pressed ? api->binding_pressed : api->binding_released;
+
+    return cb ? cb(&binding, event) : -ENOTSUP;
+}
+
+void fake_key(const char *behavior, uint32_t param1, uint32_t position, bool pressed) {
+    const int64_t now = zmk_sensor_hold_now_ms();
+
+    raise_zmk_position_state_changed((struct zmk_position_state_changed){
+        .source = ZMK_POSITION_STATE_CHANGE_SOURCE_LOCAL,
+        .position = position,
+        .state = pressed,
+        .timestamp = now,
+    });
+
+    const struct zmk_behavior_binding binding = {.behavior_dev = behavior, .param1 = param1};
+    const struct zmk_behavior_binding_event event = {
+        .layer = highest_layer,
+        .position = position,
+        .timestamp = now,
+    };
+    (void)zmk_behavior_invoke_binding(&binding, event, pressed);
+}
+
+int fake_detent(const char *behavior, int sensor_index, int layer, int delta, bool discard) {
+    const struct device *dev = zmk_behavior_get_binding(behavior);
+    if (dev == NULL) {
+        return -ENODEV;
+    }
+
+    const struct behavior_driver_api *api = dev->api;
+    struct zmk_behavior_binding binding = {.behavior_dev = behavior};
+    const struct zmk_behavior_binding_event event = {
+        .layer = layer,
+        .position = ZMK_VIRTUAL_KEY_POSITION_SENSOR(sensor_index),
+        .timestamp = zmk_sensor_hold_now_ms(),
+    };
+    const struct zmk_sensor_channel_data data = {
+        .channel = SENSOR_CHAN_ROTATION,
+        .value = {.val1 = delta},
+    };
+
+    int ret = api->sensor_binding_accept_data(&binding, event, NULL, 1, &data);
+    if (ret < 0) {
+        return ret;
+    }
+    return api->sensor_binding_process(&binding, event,
+                                       discard ? BEHAVIOR_SENSOR_BINDING_PROCESS_MODE_DISCARD
+                                               : BEHAVIOR_SENSOR_BINDING_PROCESS_MODE_TRIGGER);
+}
+
+void fake_activity(enum zmk_activity_state state) {
+    raise_zmk_activity_state_changed((struct zmk_activity_state_changed){.state = state});
+}
+
+void fake_zmk_reset(void) {
+    hid_reports = 0;
+    hid_errors = 0;
+    hid_pressed_len = 0;
+    highest_layer = 0;
+}
+
+/* ---- &kp の代わり: keycode_state_changed を出すだけ ---- */
+
+static int kp_pressed(struct zmk_behavior_binding *binding,
+                      struct zmk_behavior_binding_event event) {
+    return raise_zmk_keycode_state_changed_from_encoded(binding->param1, true, event.timestamp);
+}
+
+static int kp_released(struct zmk_behavior_binding *binding,
+                       struct zmk_behavior_binding_event event) {
+    return raise_zmk_keycode_state_changed_from_encoded(binding->param1, false, event.timestamp);
+}
+
+static const struct behavior_driver_api kp_api = {
+    .binding_pressed = kp_pressed,
+    .binding_released = kp_released,
+};
+
+#define KP_INST(n)                                                                                 \
+    BEHAVIOR_DT_INST_DEFINE(n, NULL, NULL, NULL, NULL, POST_KERNEL,                                \
+                            CONFIG_KERNEL_INIT_PRIORITY_DEFAULT, &kp_api);
+
+DT_INST_FOREACH_STATUS_OKAY(KP_INST)
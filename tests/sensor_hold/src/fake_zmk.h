@@ -0,0 +1,45 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zmk/activity.h>
+
+/*
+ * ZMK 本体の代わり（behavior の呼び出し / event / HID）
+ * - HID には keycode_state_changed を1件 = report 1件として記録する
+ * - 押下中の keycode をもう一度 press / 離れている keycode を release したら error として数える
+ *   （refcount が吸収できず HID に余計な report が出た、または release が消えた）
+ */
+
+struct fake_hid_report {
+    int64_t timestamp;
+    uint32_t encoded;
+    bool pressed;
+};
+
+void fake_zmk_reset(void);
+
+/* reset からの report 数と、直近 FAKE_HID_LOG_LEN 件の中身 */
+#define FAKE_HID_LOG_LEN 64
+size_t fake_hid_report_count(void);
+const struct fake_hid_report *fake_hid_report(size_t index);
+
+bool fake_hid_is_pressed(uint32_t encoded);
+size_t fake_hid_pressed_count(void);
+uint32_t fake_hid_errors(void);
+
+void fake_zmk_set_highest_layer(int layer);
+
+/* 物理キー: position event を出してから binding を呼ぶ（keymap と同じ順） */
+void fake_key(const char *behavior, uint32_t param1, uint32_t position, bool pressed);
+
+/* encoder の1 detent: accept_data → process（keymap の sensor event と同じ順） */
+int fake_detent(const char *behavior, int sensor_index, int layer, int delta, bool discard);
+
+void fake_activity(enum zmk_activity_state state);
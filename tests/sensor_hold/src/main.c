@@ -0,0 +1,863 @@
+/*
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <zephyr/ztest.h>
+
+#include <zmk/keymap.h>
+#include <zmk/refcount_key.h>
+#include <zmk/sensors.h>
+#include <zmk/sensor_hold_calibration.h>
+#include <zmk/sensor_hold_clock.h>
+
+#include <test_keys.h>
+
+#include "fake_zmk.h"
+
+/*
+ * 3つの behavior（hold-rotate / hold-step-rotate / refcount-key）を仮想時計の上で動かす
+ * - 時間は zmk_sensor_hold_clock_advance() でしか進まないので、timestamp まで決定的に比べられる
+ * - Kconfig で外れた機能のテストは skip する（minimal scenario）
+ * - calibration scenario では学習値の auto-apply で timeout が devicetree の値からずれるので、
+ *   sensor_hold suite は skip して sensor_hold_calibration suite だけ走らせる
+ */
+
+/* 全 timeout と watchdog（2周期）が確実に終わる時間 */
+#define SETTLE_MS 10000
+
+/* hold が全部離れているはずの無入力時間（一番長い timeout = group の hr_r） */
+#define ALL_RELEASED_AFTER_MS (TEST_HR_R_TIMEOUT_MS + 1)
+
+#define HR "hr"
+#define HR_DIRECT "hr_direct"
+#define HR_L "hr_l"
+#define HR_R "hr_r"
+#define HSR "hsr"
+#define RK "rk"
+
+static inline int64_t now(void) { return zmk_sensor_hold_now_ms(); }
+
+static inline void advance(uint32_t ms) { zmk_sensor_hold_clock_advance(ms); }
+
+static inline void detent(const char *behavior, int sensor_index, int delta) {
+    zassert_ok(fake_detent(behavior, sensor_index, 0, delta, false));
+}
+
+static void expect_report(size_t index, uint32_t encoded, bool pressed, int64_t timestamp) {
+    const struct fake_hid_report *r = fake_hid_report(index);
+
+    zassert_not_null(r, "report %zu missing (have %zu)", index, fake_hid_report_count());
+    zassert_equal(r->encoded, encoded, "report %zu: keycode 0x%06x, expected 0x%06x", index,
+                  r->encoded, encoded);
+    zassert_equal(r->pressed, pressed, "report %zu (0x%06x): pressed=%d, expected %d", index,
+                  encoded, r->pressed, pressed);
+    zassert_equal(r->timestamp, timestamp, "report %zu (0x%06x): t=%lld, expected %lld", index,
+                  encoded, (long long)r->timestamp, (long long)timestamp);
+}
+
+static void expect_reports(size_t count) {
+    zassert_equal(fake_hid_report_count(), count, "%zu reports, expected %zu",
+                  fake_hid_report_count(), count);
+    zassert_equal(fake_hid_errors(), 0, "duplicate / missing HID transitions");
+}
+
+/* step tap（PG_UP / PG_DN）を除いた hold の report だけを数える */
+static size_t hold_reports(struct fake_hid_report *out, size_t max) {
+    size_t n = 0;
+
+    for (size_t i = 0; i < fake_hid_report_count() && n < max; i++) {
+        const struct fake_hid_report *r = fake_hid_report(i);
+        if (r != NULL && r->encoded != K_PG_UP && r->encoded != K_PG_DN) {
+            out[n++] = *r;
+        }
+    }
+    return n;
+}
+
+static void before(void *fixture) {
+    ARG_UNUSED(fixture);
+
+    // 前のテストの hold / watchdog を出し切ってから記録を消す
+    advance(SETTLE_MS);
+    fake_zmk_reset();
+#if IS_ENABLED(CONFIG_ZMK_REFCOUNT_KEY_STATS)
+    zmk_refcount_key_reset_stats();
+#endif
+}
+
+static bool devicetree_timeouts(const void *global_state) {
+    ARG_UNUSED(global_state);
+    return !IS_ENABLED(CONFIG_ZMK_SENSOR_HOLD_CALIBRATION_AUTO_APPLY);
+}
+
+ZTEST_SUITE(sensor_hold, devicetree_timeouts, NULL, before, NULL, NULL);
+
+/* ---- hold-rotate ---- */
+
+ZTEST(sensor_hold, test_hold_rotate_extends_and_times_out) {
+    const int64_t t0 = now();
+
+    detent(HR, TEST_SENSOR_HR, 1);
+    for (int i = 0; i < 4; i++) {
+        advance(20);
+        detent(HR, TEST_SENSOR_HR, 1);
+    }
+    const int64_t last = now();
+
+    advance(TEST_HR_TIMEOUT_MS - 1);
+    expect_reports(1);
+    expect_report(0, K_VOL_UP, true, t0);
+
+    advance(1);
+    expect_reports(2);
+    expect_report(1, K_VOL_UP, false, last + TEST_HR_TIMEOUT_MS);
+}
+
+ZTEST(sensor_hold, test_hold_rotate_reverse_switches_hold) {
+    const int64_t t0 = now();
+
+    detent(HR, TEST_SENSOR_HR, 1);
+    advance(10);
+    detent(HR, TEST_SENSOR_HR, -1);
+    advance(SETTLE_MS);
+
+    expect_reports(4);
+    expect_report(0, K_VOL_UP, true, t0);
+    expect_report(1, K_VOL_UP, false, t0 + 10);
+    expect_report(2, K_VOL_DN, true, t0 + 10);
+    expect_report(3, K_VOL_DN, false, t0 + 10 + TEST_HR_TIMEOUT_MS);
+}
+
+ZTEST(sensor_hold, test_hold_rotate_slots_are_independent) {
+    const int64_t t0 = now();
+
+    // (sensor, layer) ごとの hot record と timer は互いの期限を動かさない
+    zassert_ok(fake_detent(HR, 0, 0, 1, false));
+    advance(30);
+    zassert_ok(fake_detent(HR, 1, 1, -1, false));
+    advance(30);
+    zassert_ok(fake_detent(HR, 0, 0, 1, false));
+    advance(SETTLE_MS);
+
+    expect_reports(4);
+    expect_report(0, K_VOL_UP, true, t0);
+    expect_report(1, K_VOL_DN, true, t0 + 30);
+    expect_report(2, K_VOL_DN, false, t0 + 30 + TEST_HR_TIMEOUT_MS);
+    expect_report(3, K_VOL_UP, false, t0 + 60 + TEST_HR_TIMEOUT_MS);
+}
+
+ZTEST(sensor_hold, test_hold_rotate_direct_dispatch_latency) {
+    static const char *const behaviors[] = {HR, HR_DIRECT};
+
+    // どちらの経路でも report は detent を処理している間に出る（queue は空なら wait=0 をその場で処理する）
+    for (int i = 0; i < ARRAY_SIZE(behaviors); i++) {
+        fake_zmk_reset();
+        const int64_t t0 = now();
+
+        detent(behaviors[i], TEST_SENSOR_HR, 1);
+        expect_reports(1);
+        expect_report(0, K_VOL_UP, true, t0);
+
+        advance(10);
+        detent(behaviors[i], TEST_SENSOR_HR, -1);
+        expect_reports(3);
+        expect_report(1, K_VOL_UP, false, t0 + 10);
+        expect_report(2, K_VOL_DN, true, t0 + 10);
+
+        advance(SETTLE_MS);
+        expect_reports(4);
+        TC_PRINT("%s: detent-to-report latency %lld ms\n", behaviors[i],
+                 (long long)(fake_hid_report(0)->timestamp - t0));
+    }
+}
+
+ZTEST(sensor_hold, test_hold_rotate_discard_and_zero_delta_are_transparent) {
+    zassert_equal(fake_detent(HR, TEST_SENSOR_HR, 0, 1, true), ZMK_BEHAVIOR_TRANSPARENT);
+    zassert_equal(fake_detent(HR, TEST_SENSOR_HR, 0, 0, false), ZMK_BEHAVIOR_TRANSPARENT);
+    advance(SETTLE_MS);
+    expect_reports(0);
+}
+
+/* ---- hold-step-rotate ---- */
+
+ZTEST(sensor_hold, test_step_rotate_anti_reverse) {
+    if (!IS_ENABLED(CONFIG_ZMK_BEHAVIOR_SENSOR_HOLD_STEP_ROTATE_ANTI_REVERSE)) {
+        ztest_test_skip();
+    }
+
+    struct fake_hid_report r[8];
+    const int64_t t0 = now();
+
+    // 逆方向の1 detent が anti-reverse-ms 以内ならチャタリングとして直前の方向に丸める
+    detent(HSR, TEST_SENSOR_HSR, 1);
+    advance(TEST_ANTI_REVERSE_MS / 2);
+    detent(HSR, TEST_SENSOR_HSR, -1);
+    zassert_equal(hold_reports(r, ARRAY_SIZE(r)), 1);
+
+    // 超えたら本当の反転
+    advance(TEST_ANTI_REVERSE_MS + 1);
+    const int64_t t_rev = now();
+    detent(HSR, TEST_SENSOR_HSR, -1);
+    advance(SETTLE_MS);
+
+    zassert_equal(hold_reports(r, ARRAY_SIZE(r)), 4);
+    zassert_equal(fake_hid_errors(), 0);
+    zassert_true(r[0].encoded == K_UP && r[0].pressed && r[0].timestamp == t0);
+    zassert_true(r[1].encoded == K_UP && !r[1].pressed && r[1].timestamp == t_rev);
+    zassert_true(r[2].encoded == K_DOWN && r[2].pressed && r[2].timestamp == t_rev);
+    zassert_true(r[3].encoded == K_DOWN && !r[3].pressed &&
+                 r[3].timestamp == t_rev + TEST_HSR_TIMEOUT_MS);
+}
+
+ZTEST(sensor_hold, test_step_rotate_step_taps) {
+    if (!IS_ENABLED(CONFIG_ZMK_BEHAVIOR_SENSOR_HOLD_STEP_ROTATE_STEP)) {
+        ztest_test_skip();
+    }
+
+    const int64_t t0 = now();
+
+    for (int i = 0; i < 2 * TEST_STEP_GROUP_SIZE + 1; i++) {
+        detent(HSR, TEST_SENSOR_HSR, 1);
+        advance(10);
+    }
+    advance(SETTLE_MS);
+
+    // hold press → (step_group_size 回目ごとに tap) → timeout で release
+    const int64_t t_tap0 = t0 + 10 * (TEST_STEP_GROUP_SIZE - 1);
+    const int64_t t_tap1 = t0 + 10 * (2 * TEST_STEP_GROUP_SIZE - 1);
+    const int64_t t_last = t0 + 10 * (2 * TEST_STEP_GROUP_SIZE);
+
+    expect_reports(6);
+    expect_report(0, K_UP, true, t0);
+    expect_report(1, K_PG_UP, true, t_tap0);
+    expect_report(2, K_PG_UP, false, t_tap0);
+    expect_report(3, K_PG_UP, true, t_tap1);
+    expect_report(4, K_PG_UP, false, t_tap1);
+    expect_report(5, K_UP, false, t_last + TEST_HSR_TIMEOUT_MS);
+}
+
+ZTEST(sensor_hold, test_step_rotate_quick_release) {
+    if (!IS_ENABLED(CONFIG_ZMK_BEHAVIOR_SENSOR_HOLD_STEP_ROTATE_QUICK_RELEASE)) {
+        ztest_test_skip();
+    }
+
+    const int64_t t0 = now();
+
+    detent(HSR, TEST_SENSOR_HSR, 1);
+    advance(10);
+
+    // allow-list と modifier では離さない
+    fake_key(RK, K_ALLOWED, 2, true);
+    fake_key(RK, K_ALLOWED, 2, false);
+    fake_key(RK, K_LSHIFT, 3, true);
+    fake_key(RK, K_LSHIFT, 3, false);
+    zassert_true(fake_hid_is_pressed(K_UP));
+
+    // それ以外のキーで即 release、timeout は取り消される
+    advance(10);
+    const int64_t t_other = now();
+    fake_key(RK, K_OTHER, 4, true);
+    zassert_false(fake_hid_is_pressed(K_UP));
+    fake_key(RK, K_OTHER, 4, false);
+    advance(SETTLE_MS);
+
+    expect_reports(8);
+    expect_report(0, K_UP, true, t0);
+    expect_report(5, K_OTHER, true, t_other);
+    expect_report(6, K_UP, false, t_other);
+    expect_report(7, K_OTHER, false, t_other);
+}
+
+ZTEST(sensor_hold, test_step_rotate_flush_on_idle) {
+    if (!IS_ENABLED(CONFIG_ZMK_SENSOR_HOLD_FLUSH_ON_IDLE)) {
+        ztest_test_skip();
+    }
+
+    detent(HR, TEST_SENSOR_HR, 1);
+    detent(HSR, TEST_SENSOR_HSR, -1);
+    advance(10);
+    zassert_equal(fake_hid_pressed_count(), 2);
+
+    const int64_t t_idle = now();
+    fake_activity(ZMK_ACTIVITY_IDLE);
+    zassert_equal(fake_hid_pressed_count(), 0);
+    fake_activity(ZMK_ACTIVITY_ACTIVE);
+
+    // timeout は取り消されているので後から report は出ない
+    advance(SETTLE_MS);
+    expect_reports(4);
+    expect_report(2, K_VOL_UP, false, t_idle);
+    expect_report(3, K_DOWN, false, t_idle);
+}
+
+/* ---- refcount-key ---- */
+
+ZTEST(sensor_hold, test_refcount_shares_keycode_with_knob_hold) {
+    if (!IS_ENABLED(CONFIG_ZMK_REFCOUNT_KEY_ROUTE_KP)) {
+        ztest_test_skip();
+    }
+
+    const int64_t t0 = now();
+
+    // 物理キーと knob が同じ keycode: 0->1 の press と 1->0 の release だけが HID に届く
+    fake_key(RK, K_VOL_UP, 0, true);
+    advance(10);
+    detent(HR, TEST_SENSOR_HR, 1);
+    advance(10);
+    fake_key(RK, K_VOL_UP, 0, false);
+    zassert_true(fake_hid_is_pressed(K_VOL_UP));
+
+    advance(SETTLE_MS);
+    expect_reports(2);
+    expect_report(0, K_VOL_UP, true, t0);
+    expect_report(1, K_VOL_UP, false, t0 + 10 + TEST_HR_TIMEOUT_MS);
+
+#if IS_ENABLED(CONFIG_ZMK_REFCOUNT_KEY_STATS)
+    struct zmk_refcount_key_stats stats;
+    zmk_refcount_key_get_stats(&stats);
+    zassert_equal(stats.emitted, 2);
+    zassert_equal(stats.absorbed, 2);
+#endif
+}
+
+ZTEST(sensor_hold, test_refcount_physical_position_is_idempotent) {
+    fake_key(RK, K_OTHER, 1, true);
+    fake_key(RK, K_OTHER, 1, true);
+    fake_key(RK, K_OTHER, 1, false);
+    expect_reports(2);
+    fake_key(RK, K_OTHER, 1, false);
+    expect_reports(2);
+}
+
+ZTEST(sensor_hold, test_refcount_watchdog_releases_stuck_key) {
+#if CONFIG_ZMK_REFCOUNT_KEY_WATCHDOG_MS > 0
+    const int64_t t0 = now();
+
+    // 物理的には押されていない position（position event 無し）から press だけ届いた
+    zassert_equal(zmk_refcount_key_press(K_OTHER, 5, t0), 1);
+
+    // 2周期連続で食い違ったら離す
+    advance(2 * CONFIG_ZMK_REFCOUNT_KEY_WATCHDOG_MS - 1);
+    zassert_true(fake_hid_is_pressed(K_OTHER));
+    advance(1);
+    zassert_false(fake_hid_is_pressed(K_OTHER));
+
+    expect_reports(2);
+    expect_report(1, K_OTHER, false, t0 + 2 * CONFIG_ZMK_REFCOUNT_KEY_WATCHDOG_MS);
+
+    // 本当に押している間は離さない
+    fake_key(RK, K_OTHER, 5, true);
+    advance(5 * CONFIG_ZMK_REFCOUNT_KEY_WATCHDOG_MS);
+    zassert_true(fake_hid_is_pressed(K_OTHER));
+    fake_key(RK, K_OTHER, 5, false);
+    expect_reports(4);
+#else
+    ztest_test_skip();
+#endif
+}
+
+/* ---- idle 中の wakeup ---- */
+
+/* hold を持つ間に refcount-key の watchdog が最後に1回だけ見に来る分 */
+#define WATCHDOG_WAKEUPS (CONFIG_ZMK_REFCOUNT_KEY_WATCHDOG_MS > 0 ? 1 : 0)
+
+ZTEST(sensor_hold, test_idle_has_no_timer_wakeups) {
+    const uint32_t w0 = zmk_sensor_hold_clock_wakeups();
+
+    // 回している間は期限を延ばすだけ（watchdog の1周期より短く回す）
+    for (int i = 0; i < 40; i++) {
+        detent(HR, TEST_SENSOR_HR, 1);
+        detent(HSR, TEST_SENSOR_HSR, 1);
+        advance(20);
+    }
+    zassert_equal(zmk_sensor_hold_clock_wakeups(), w0, "wakeup while rotating");
+
+    // hold 1回につき timeout 1回
+    advance(SETTLE_MS);
+    zassert_equal(zmk_sensor_hold_clock_wakeups() - w0, 2 + WATCHDOG_WAKEUPS);
+    zassert_equal(zmk_sensor_hold_clock_armed(), 0);
+
+    // 何も押していなければ1時間たっても1回も起きない
+    const uint32_t w1 = zmk_sensor_hold_clock_wakeups();
+    advance(60 * 60 * 1000);
+    zassert_equal(zmk_sensor_hold_clock_wakeups(), w1);
+    zassert_equal(zmk_sensor_hold_clock_armed(), 0);
+
+    TC_PRINT("idle: %u wakeups for 80 detents, 0 in 1 h idle\n", w1 - w0);
+}
+
+ZTEST(sensor_hold, test_idle_event_cancels_timeouts) {
+    if (!IS_ENABLED(CONFIG_ZMK_SENSOR_HOLD_FLUSH_ON_IDLE)) {
+        ztest_test_skip();
+    }
+
+    detent(HR, TEST_SENSOR_HR, 1);
+    detent(HSR, TEST_SENSOR_HSR, 1);
+    advance(10);
+
+    // idle で hold の timeout は取り消す。残るのは watchdog の最後の1回だけ
+    const uint32_t w0 = zmk_sensor_hold_clock_wakeups();
+    fake_activity(ZMK_ACTIVITY_IDLE);
+    zassert_equal(zmk_sensor_hold_clock_armed(), WATCHDOG_WAKEUPS);
+    advance(SETTLE_MS);
+    zassert_equal(zmk_sensor_hold_clock_wakeups() - w0, WATCHDOG_WAKEUPS);
+    fake_activity(ZMK_ACTIVITY_ACTIVE);
+}
+
+/* ---- group（hr_l + hr_r） ---- */
+
+ZTEST(sensor_hold, test_group_chord_follows_both_knobs) {
+    if (!IS_ENABLED(CONFIG_ZMK_BEHAVIOR_SENSOR_HOLD_ROTATE_GROUP)) {
+        ztest_test_skip();
+    }
+
+    // 左だけ: press は chord-window-ms だけ待たせる
+    detent(HR_L, 0, 1);
+    advance(10);
+    expect_reports(0);
+
+    // 右も window 内に動いた: 個別 hold を出さずに chord [CW,CCW] だけを press する
+    const int64_t t_chord = now();
+    detent(HR_R, 1, -1);
+    zassert_true(fake_hid_is_pressed(K_CHORD_1));
+    zassert_false(fake_hid_is_pressed(K_L_CW));
+
+    for (int i = 0; i < 3; i++) {
+        advance(10);
+        detent(HR_L, 0, 1);
+        advance(10);
+        detent(HR_R, 1, -1);
+    }
+    const int64_t t_right_last = now();
+    expect_reports(1);
+
+    // 右が止まり左だけ回り続ける: 右の detent が window を過ぎたら個別 hold に戻す
+    int64_t t_drop = -1;
+    for (int i = 0; i < 6; i++) {
+        advance(10);
+        detent(HR_L, 0, 1);
+        if (t_drop < 0 && !fake_hid_is_pressed(K_CHORD_1)) {
+            t_drop = now();
+        }
+    }
+    const int64_t t_left_last = now();
+
+    zassert_equal(t_drop, t_right_last + 10 * (TEST_CHORD_WINDOW_MS / 10 + 1),
+                  "chord dropped at %lld", (long long)t_drop);
+    zassert_true(fake_hid_is_pressed(K_L_CW));
+    zassert_true(fake_hid_is_pressed(K_R_CCW));
+
+    // 共有の期限（遅い方の timeout）で一緒に離す
+    advance(SETTLE_MS);
+    expect_reports(6);
+    expect_report(0, K_CHORD_1, true, t_chord);
+    expect_report(1, K_CHORD_1, false, t_drop);
+    expect_report(2, K_L_CW, true, t_drop);
+    expect_report(3, K_R_CCW, true, t_drop);
+    expect_report(4, K_L_CW, false, t_left_last + TEST_HR_R_TIMEOUT_MS);
+    expect_report(5, K_R_CCW, false, t_left_last + TEST_HR_R_TIMEOUT_MS);
+}
+
+ZTEST(sensor_hold, test_group_single_knob_waits_for_chord_window) {
+    if (!IS_ENABLED(CONFIG_ZMK_BEHAVIOR_SENSOR_HOLD_ROTATE_GROUP)) {
+        ztest_test_skip();
+    }
+
+    const int64_t t0 = now();
+
+    // 相方が来なければ window の終わりに個別 hold を出す
+    detent(HR_L, 0, -1);
+    advance(TEST_CHORD_WINDOW_MS - 1);
+    expect_reports(0);
+    advance(1);
+    expect_reports(1);
+    expect_report(0, K_L_CCW, true, t0 + TEST_CHORD_WINDOW_MS);
+
+    // 出した後の detent は期限を延ばすだけ
+    advance(20);
+    detent(HR_L, 0, -1);
+    const int64_t t_last = now();
+    advance(TEST_CHORD_WINDOW_MS + 10);
+    zassert_true(fake_hid_is_pressed(K_L_CCW));
+    advance(SETTLE_MS);
+
+    expect_reports(2);
+    expect_report(1, K_L_CCW, false, t_last + TEST_HR_L_TIMEOUT_MS);
+}
+
+/* ---- long session / fuzz / throughput ---- */
+
+static uint32_t rng_state;
+
+static uint32_t rng(void) {
+    // xorshift32: seed ごとに同じ列になる（失敗したら seed で再現できる）
+    uint32_t x = rng_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return rng_state = x;
+}
+
+static uint32_t rng_range(uint32_t lo, uint32_t hi) { return lo + rng() % (hi - lo + 1); }
+
+/* keymap: layer 0 = hr / hsr, layer 1 = group（hr_l / hr_r） */
+static const char *const sensor_bindings[ZMK_KEYMAP_LAYERS_LEN][ZMK_KEYMAP_SENSORS_LEN] = {
+    {HR, HSR},
+    {HR_L, HR_R},
+};
+
+/* 物理キー（すべて &rk）。knob と keycode を共有するものを含む */
+static const uint32_t key_bindings[] = {K_VOL_UP, K_UP, K_ALLOWED, K_OTHER};
+
+struct session_result {
+    uint32_t detents;
+    uint32_t reports;
+    uint32_t idle_checks;
+    int64_t duration_ms;
+};
+
+/*
+ * ランダムな操作列を流して不変条件を見る
+ * - HID に重複 press / 行方不明の release が出ない（refcount が効いている）
+ * - 一番長い timeout より長く無入力なら、押している物理キー以外は全部離れている
+ * - 最後に全部離れる
+ * fuzz では delta 0 / DISCARD / idle event / layer 変更も混ぜる
+ */
+static struct session_result run_session(uint32_t seed, int64_t duration_ms, bool fuzz) {
+    struct session_result res = {0};
+    bool key_down[ARRAY_SIZE(key_bindings)] = {0};
+    int dir[ZMK_KEYMAP_SENSORS_LEN] = {1, -1};
+    int layer = 0;
+
+    rng_state = seed;
+    const int64_t start = now();
+    const int64_t end = start + duration_ms;
+
+    for (uint32_t step = 0; now() < end; step++) {
+        const uint32_t action = rng() % 100;
+
+        if (action < 85) {
+            const int si = rng() % ZMK_KEYMAP_SENSORS_LEN;
+            if (rng() % 10 == 0) {
+                dir[si] = -dir[si];
+            }
+            int delta = dir[si];
+            bool discard = false;
+            if (fuzz) {
+                delta = (rng() % 20 == 0) ? 0 : delta * (int)rng_range(1, 3);
+                discard = (rng() % 20 == 0);
+            }
+            (void)fake_detent(sensor_bindings[layer][si], si, layer, delta, discard);
+            res.detents++;
+        } else if (action < 93) {
+            const int k = rng() % ARRAY_SIZE(key_bindings);
+            key_down[k] = !key_down[k];
+            fake_key(RK, key_bindings[k], k, key_down[k]);
+        } else if (action < 96) {
+            if (fuzz || rng() % 4 == 0) {
+                layer = rng() % ZMK_KEYMAP_LAYERS_LEN;
+                fake_zmk_set_highest_layer(layer);
+            }
+        } else if (fuzz) {
+            fake_activity(ZMK_ACTIVITY_IDLE);
+            fake_activity(ZMK_ACTIVITY_ACTIVE);
+        }
+
+        // 回している間の間隔 / 手を止めた間隔 / 長い休み
+        const uint32_t p = rng() % 100;
+        const uint32_t gap = (p < 80) ? rng_range(2, 40)
+                             : (p < 97) ? rng_range(41, 600)
+                                        : rng_range(1000, 30000);
+        advance(gap);
+
+        zassert_equal(fake_hid_errors(), 0, "seed 0x%08x step %u: HID transition error", seed,
+                      step);
+
+        if (gap >= ALL_RELEASED_AFTER_MS) {
+            size_t down = 0;
+            for (int k = 0; k < ARRAY_SIZE(key_bindings); k++) {
+                down += key_down[k];
+            }
+            zassert_equal(fake_hid_pressed_count(), down,
+                          "seed 0x%08x step %u: %zu keys pressed after %u ms idle, %zu held",
+                          seed, step, fake_hid_pressed_count(), gap, down);
+            res.idle_checks++;
+        }
+    }
+
+    for (int k = 0; k < ARRAY_SIZE(key_bindings); k++) {
+        if (key_down[k]) {
+            fake_key(RK, key_bindings[k], k, false);
+        }
+    }
+    fake_zmk_set_highest_layer(0);
+    advance(SETTLE_MS);
+
+    zassert_equal(fake_hid_pressed_count(), 0, "seed 0x%08x: keys left pressed", seed);
+    zassert_equal(fake_hid_errors(), 0, "seed 0x%08x: HID transition error", seed);
+
+    res.reports = fake_hid_report_count();
+    res.duration_ms = now() - start;
+    return res;
+}
+
+ZTEST(sensor_hold, test_long_session_replay) {
+    // 8 時間ぶんの操作を仮想時計で流す
+    const struct session_result res = run_session(0x5eed0001, 8LL * 60 * 60 * 1000, false);
+
+    TC_PRINT("long session: %u detents, %u HID reports, %u idle checks, %lld s simulated\n",
+             res.detents, res.reports, res.idle_checks, (long long)(res.duration_ms / 1000));
+    zassert_true(res.idle_checks > 0);
+}
+
+ZTEST(sensor_hold, test_refcount_report_savings) {
+    if (!IS_ENABLED(CONFIG_ZMK_REFCOUNT_KEY_ROUTE_KP) ||
+        !IS_ENABLED(CONFIG_ZMK_REFCOUNT_KEY_STATS)) {
+        ztest_test_skip();
+    }
+
+#if IS_ENABLED(CONFIG_ZMK_REFCOUNT_KEY_STATS)
+    // 1 時間ぶん。knob と物理キーが keycode を共有する（K_VOL_UP / K_UP）
+    const struct session_result res = run_session(0x5eed0002, 60LL * 60 * 1000, false);
+    struct zmk_refcount_key_stats stats;
+    zmk_refcount_key_get_stats(&stats);
+
+    // 共有テーブルを通らなければ absorbed の分も HID に出ていた（重複 press / 早すぎる release）
+    zassert_equal(stats.emitted, res.reports);
+    zassert_true(stats.absorbed > 0);
+    TC_PRINT("refcount: %u HID reports with the shared table, %u without (%u absorbed)\n",
+             stats.emitted, stats.emitted + stats.absorbed, stats.absorbed);
+#endif
+}
+
+ZTEST(sensor_hold, test_fuzz) {
+    for (uint32_t seed = 1; seed <= 16; seed++) {
+        const struct session_result res = run_session(seed * 0x9e3779b9, 10LL * 60 * 1000, true);
+
+        zassert_true(res.detents > 0);
+        fake_zmk_reset();
+    }
+}
+
+/*
+ * CPU コスト
+ * - fake_detent（accept_data → process → dispatch → fake HID）だけを k_cycle_get_32 で挟んで測る。
+ *   advance（仮想時計の timer 処理）は含めない。1 detent は短いので 32bit の差分で足りる
+ * - native_sim の cycle counter はシミュレーション時間で、処理中は進まないので 0 になる。
+ *   qemu（icount）や実機では命令数に比例した値が出る
+ * - 上限は nRF52（64 MHz）で 1 detent が BLE の1 report 間隔（7.5 ms）に比べて十分小さいことを見る程度
+ */
+#define DETENT_BUDGET_NS 50000
+
+struct detent_cost {
+    uint64_t cycles;
+    uint32_t detents;
+};
+
+static void timed_detent(struct detent_cost *cost, const char *behavior, int sensor_index,
+                         int delta) {
+    const uint32_t c0 = k_cycle_get_32();
+
+    detent(behavior, sensor_index, delta);
+    cost->cycles += (uint32_t)(k_cycle_get_32() - c0);
+    cost->detents++;
+}
+
+static void report_cost(const char *what, const struct detent_cost *cost) {
+    const uint64_t ns = k_cyc_to_ns_floor64(cost->cycles) / cost->detents;
+
+    TC_PRINT("%s: %u detents, %llu cycles/detent, %llu ns/detent\n", what, cost->detents,
+             (unsigned long long)(cost->cycles / cost->detents), (unsigned long long)ns);
+    zassert_true(ns <= DETENT_BUDGET_NS, "%s: %llu ns per detent (budget %u)", what,
+                 (unsigned long long)ns, DETENT_BUDGET_NS);
+}
+
+ZTEST(sensor_hold, test_throughput_continuous_rotation) {
+    // 1 ms 間隔で回し続けても hold は1回の press / release、queue は溢れない
+    const int detents = 100000;
+    struct detent_cost hr = {0};
+    struct detent_cost hsr = {0};
+
+    for (int i = 0; i < detents; i++) {
+        timed_detent(&hr, HR, TEST_SENSOR_HR, 1);
+        advance(1);
+    }
+    advance(SETTLE_MS);
+    expect_reports(2);
+
+    fake_zmk_reset();
+    for (int i = 0; i < detents; i++) {
+        timed_detent(&hsr, HSR, TEST_SENSOR_HSR, 1);
+        advance(1);
+    }
+    advance(SETTLE_MS);
+
+    const size_t taps = IS_ENABLED(CONFIG_ZMK_BEHAVIOR_SENSOR_HOLD_STEP_ROTATE_STEP)
+                            ? 2 * (detents / TEST_STEP_GROUP_SIZE)
+                            : 0;
+    expect_reports(2 + taps);
+
+    TC_PRINT("throughput: %d detents per behavior, hold-step-rotate %zu HID reports\n", detents,
+             fake_hid_report_count());
+    report_cost("hold-rotate continuous", &hr);
+    report_cost("hold-step-rotate continuous", &hsr);
+}
+
+ZTEST(sensor_hold, test_detent_cost_by_path) {
+    // hot path ごとのコスト: 同じ向き（期限の延長だけ）と反転（release + press）
+    static const struct {
+        const char *behavior;
+        int sensor_index;
+        const char *extend;
+        const char *reverse;
+    } cases[] = {
+        {HR, TEST_SENSOR_HR, "hold-rotate extend", "hold-rotate reverse"},
+        {HSR, TEST_SENSOR_HSR, "hold-step-rotate extend", "hold-step-rotate reverse"},
+    };
+    const int detents = 1000;
+
+    for (int c = 0; c < ARRAY_SIZE(cases); c++) {
+        struct detent_cost extend = {0};
+        struct detent_cost reverse = {0};
+
+        for (int i = 0; i < detents; i++) {
+            timed_detent(&extend, cases[c].behavior, cases[c].sensor_index, 1);
+            advance(10);
+        }
+        // anti-reverse-ms より長く、timeout より短い間隔で反転させる
+        for (int i = 0; i < detents; i++) {
+            timed_detent(&reverse, cases[c].behavior, cases[c].sensor_index, (i % 2) ? 1 : -1);
+            advance(TEST_ANTI_REVERSE_MS + 10);
+        }
+        advance(SETTLE_MS);
+        zassert_equal(fake_hid_pressed_count(), 0);
+        zassert_equal(fake_hid_errors(), 0);
+
+        report_cost(cases[c].extend, &extend);
+        report_cost(cases[c].reverse, &reverse);
+        fake_zmk_reset();
+    }
+}
+
+/* ---- calibration（auto-apply まで見るので AUTO_APPLY の scenario だけ） ---- */
+
+#if IS_ENABLED(CONFIG_ZMK_SENSOR_HOLD_CALIBRATION_AUTO_APPLY)
+
+#define CAL_N CONFIG_ZMK_SENSOR_HOLD_CALIBRATION_MIN_SAMPLES
+#define CAL_MARGIN_MS CONFIG_ZMK_SENSOR_HOLD_CALIBRATION_MARGIN_MS
+
+/* どの timeout よりも長い休み（hold が切れるので記録されない） */
+#define CAL_PAUSE_MS 300
+
+/*
+ * 期待値はバケットの上端: 10 ms -> 12、40 ms -> 48、60 ms -> 64、6 ms -> 8
+ * - サンプルがすべて一番上のバケットまで積まれていれば p99.9 / p99 はそのバケットになる（N <= 500）
+ * - 2 round 目の 60 ms は 1 round 目で適用した timeout（48 + margin）より短くないと記録されない
+ */
+#define CAL_ROUND1_TIMEOUT_MS (48 + CAL_MARGIN_MS)
+#define CAL_ROUND2_TIMEOUT_MS (64 + CAL_MARGIN_MS)
+#define CAL_ANTI_REVERSE_MS (8 + CAL_MARGIN_MS / 4)
+
+BUILD_ASSERT(CAL_N <= 500, "expected values assume at most 500 samples per round");
+BUILD_ASSERT(60 < CAL_ROUND1_TIMEOUT_MS, "round 2 gaps must keep the learned hold alive");
+BUILD_ASSERT(CAL_PAUSE_MS > TEST_HR_R_TIMEOUT_MS, "pauses must release every hold");
+
+static void cal_before(void *fixture) {
+    before(fixture);
+    for (int i = 0; i < ZMK_KEYMAP_SENSORS_LEN; i++) {
+        zmk_sensor_hold_cal_reset(i);
+        zmk_sensor_hold_cal_clear(i);
+    }
+}
+
+ZTEST_SUITE(sensor_hold_calibration, NULL, NULL, cal_before, NULL, NULL);
+
+static struct zmk_sensor_hold_cal_recommendation recommend(int sensor_index) {
+    struct zmk_sensor_hold_cal_recommendation rec;
+
+    zassert_ok(zmk_sensor_hold_cal_recommend(sensor_index, &rec));
+    return rec;
+}
+
+ZTEST(sensor_hold_calibration, test_calibration_timeout_from_gaps) {
+    const int s = TEST_SENSOR_HR;
+
+    // 1 round 目: 40 ms が1個と 10 ms が N-1 個。10 detent ごとの休みは数えない
+    detent(HR, s, 1);
+    for (int i = 0; i < CAL_N; i++) {
+        if (i % 10 == 9) {
+            advance(CAL_PAUSE_MS);
+            detent(HR, s, 1);
+        }
+        zassert_equal(recommend(s).samples, i);
+        zassert_equal(zmk_sensor_hold_cal_timeout_ms(s, TEST_HR_TIMEOUT_MS), TEST_HR_TIMEOUT_MS,
+                      "applied after %d gaps", i);
+        advance(i == 0 ? 40 : 10);
+        detent(HR, s, 1);
+    }
+
+    struct zmk_sensor_hold_cal_recommendation rec = recommend(s);
+    zassert_equal(rec.samples, CAL_N);
+    zassert_equal(rec.timeout_ms, CAL_ROUND1_TIMEOUT_MS);
+    zassert_equal(zmk_sensor_hold_cal_timeout_ms(s, TEST_HR_TIMEOUT_MS), CAL_ROUND1_TIMEOUT_MS);
+
+    // 2 round 目: 次の倍数（2N）までは 1 round 目の値のまま
+    for (int i = 0; i < CAL_N; i++) {
+        zassert_equal(zmk_sensor_hold_cal_timeout_ms(s, TEST_HR_TIMEOUT_MS),
+                      CAL_ROUND1_TIMEOUT_MS, "re-applied after %d gaps", CAL_N + i);
+        advance(60);
+        detent(HR, s, 1);
+    }
+    const int64_t t_last = now();
+
+    rec = recommend(s);
+    zassert_equal(rec.samples, 2 * CAL_N);
+    zassert_equal(rec.timeout_ms, CAL_ROUND2_TIMEOUT_MS);
+    zassert_equal(zmk_sensor_hold_cal_timeout_ms(s, TEST_HR_TIMEOUT_MS), CAL_ROUND2_TIMEOUT_MS);
+
+    // behavior も適用した値で離す
+    advance(SETTLE_MS);
+    expect_report(fake_hid_report_count() - 1, K_VOL_UP, false, t_last + CAL_ROUND2_TIMEOUT_MS);
+    zassert_equal(fake_hid_errors(), 0);
+}
+
+ZTEST(sensor_hold_calibration, test_calibration_anti_reverse_needs_min_samples) {
+    const int s = TEST_SENSOR_HSR;
+
+    // CW -> 6 ms -> CCW -> 6 ms -> CW の逆向き1発を N 回。間の休みは detent 間隔として数えない
+    for (int i = 0; i < CAL_N; i++) {
+        const struct zmk_sensor_hold_cal_recommendation rec = recommend(s);
+        zassert_equal(rec.chatter_samples, i);
+        zassert_equal(rec.anti_reverse_ms, 0, "recommended after %d reversals", i);
+
+        detent(HSR, s, 1);
+        advance(6);
+        detent(HSR, s, -1);
+        advance(6);
+        detent(HSR, s, 1);
+        advance(CAL_PAUSE_MS);
+    }
+
+    struct zmk_sensor_hold_cal_recommendation rec = recommend(s);
+    zassert_equal(rec.chatter_samples, CAL_N);
+    zassert_equal(rec.samples, 0);
+    zassert_equal(rec.anti_reverse_ms, CAL_ANTI_REVERSE_MS);
+
+    // timeout のデータが足りないうちは適用しない
+    zassert_equal(zmk_sensor_hold_cal_apply(s), -EAGAIN);
+    zassert_equal(zmk_sensor_hold_cal_anti_reverse_ms(s, TEST_ANTI_REVERSE_MS),
+                  TEST_ANTI_REVERSE_MS);
+
+    // N 個目の detent 間隔で auto-apply され、anti-reverse も一緒に入る
+    detent(HSR, s, 1);
+    for (int i = 0; i < CAL_N; i++) {
+        advance(10);
+        detent(HSR, s, 1);
+    }
+    zassert_equal(zmk_sensor_hold_cal_anti_reverse_ms(s, TEST_ANTI_REVERSE_MS),
+                  CAL_ANTI_REVERSE_MS);
+    // devicetree で 0（無効）の instance は上書きしない
+    zassert_equal(zmk_sensor_hold_cal_anti_reverse_ms(s, 0), 0);
+}
+
+#endif